@@ -0,0 +1,276 @@
+#include "Candidates.h"
+#include "Value.h"
+
+#include <algorithm>
+
+namespace {
+  typedef size_t (*BitmapKernel)(uint64_t* const bitmap,
+                                 size_t const words,
+                                 size_t const last,
+                                 uint8_t const* const data1,
+                                 uint8_t const* const data2,
+                                 uint32_t const value);
+
+  typedef size_t (*OffsetsKernel)(std::vector<uint32_t>* const offsets,
+                                  size_t const last,
+                                  uint8_t const* const data1,
+                                  uint8_t const* const data2,
+                                  uint32_t const value);
+
+  struct Kernels {
+    BitmapKernel  bitmap;
+    OffsetsKernel offsets;
+  };
+}
+
+// V is true when comparing against a constant value instead of another snapshot.
+template<size_t S, Snapshot::Format F, Snapshot::Operator O, bool V>
+static inline bool test(uint8_t const* const data1, uint8_t const* const data2, uint32_t const value, size_t const offset) {
+  uint32_t const v1 = read<S, F>(data1 + offset);
+  uint32_t const v2 = V ? value : read<S, F>(data2 + offset);
+  return compare<O>(v1, v2);
+}
+
+template<size_t S, Snapshot::Format F, Snapshot::Operator O, bool V>
+static size_t filterBitmap(uint64_t* const bitmap,
+                           size_t const words,
+                           size_t const last,
+                           uint8_t const* const data1,
+                           uint8_t const* const data2,
+                           uint32_t const value) {
+
+  size_t count = 0;
+
+  for (size_t w = 0; w < words; w++) {
+    uint64_t bits = bitmap[w];
+
+    if (bits == 0) {
+      continue;
+    }
+
+    size_t const base = w * 64;
+    uint64_t keep = 0;
+
+    if (base + 64 <= last) {
+      // Branchless so that fully populated words are cheap to evaluate
+      for (unsigned b = 0; b < 64; b++) {
+        keep |= static_cast<uint64_t>(test<S, F, O, V>(data1, data2, value, base + b)) << b;
+      }
+    }
+    else {
+      for (unsigned b = 0; base + b < last; b++) {
+        keep |= static_cast<uint64_t>(test<S, F, O, V>(data1, data2, value, base + b)) << b;
+      }
+    }
+
+    bits &= keep;
+    bitmap[w] = bits;
+    count += __builtin_popcountll(bits);
+  }
+
+  return count;
+}
+
+template<size_t S, Snapshot::Format F, Snapshot::Operator O, bool V>
+static size_t filterOffsets(std::vector<uint32_t>* const offsets,
+                            size_t const last,
+                            uint8_t const* const data1,
+                            uint8_t const* const data2,
+                            uint32_t const value) {
+
+  auto out = offsets->begin();
+
+  for (auto const offset : *offsets) {
+    if (offset < last && test<S, F, O, V>(data1, data2, value, offset)) {
+      *out++ = offset;
+    }
+  }
+
+  offsets->erase(out, offsets->end());
+  return offsets->size();
+}
+
+template<size_t S, Snapshot::Format F, Snapshot::Operator O>
+static Kernels kernels(bool const v) {
+  if (v) {
+    return Kernels{filterBitmap<S, F, O, true>, filterOffsets<S, F, O, true>};
+  }
+  else {
+    return Kernels{filterBitmap<S, F, O, false>, filterOffsets<S, F, O, false>};
+  }
+}
+
+template<size_t S, Snapshot::Format F>
+static Kernels kernels(Snapshot::Operator const op, bool const v) {
+  switch (op) {
+    default: // never happens
+    case Snapshot::Operator::LessThan:     return kernels<S, F, Snapshot::Operator::LessThan>(v);
+    case Snapshot::Operator::LessEqual:    return kernels<S, F, Snapshot::Operator::LessEqual>(v);
+    case Snapshot::Operator::GreaterThan:  return kernels<S, F, Snapshot::Operator::GreaterThan>(v);
+    case Snapshot::Operator::GreaterEqual: return kernels<S, F, Snapshot::Operator::GreaterEqual>(v);
+    case Snapshot::Operator::Equal:        return kernels<S, F, Snapshot::Operator::Equal>(v);
+    case Snapshot::Operator::NotEqual:     return kernels<S, F, Snapshot::Operator::NotEqual>(v);
+  }
+}
+
+template<size_t S>
+static Kernels kernels(Snapshot::Format const format, Snapshot::Operator const op, bool const v) {
+  switch (format) {
+    default: // never happens
+    case Snapshot::Format::UIntLittleEndian: return kernels<S, Snapshot::Format::UIntLittleEndian>(op, v);
+    case Snapshot::Format::UIntBigEndian:    return kernels<S, Snapshot::Format::UIntBigEndian>(op, v);
+    case Snapshot::Format::BCDLittleEndian:  return kernels<S, Snapshot::Format::BCDLittleEndian>(op, v);
+    case Snapshot::Format::BCDBigEndian:     return kernels<S, Snapshot::Format::BCDBigEndian>(op, v);
+  }
+}
+
+static Kernels kernels(Snapshot::Size const bits, Snapshot::Format const format, Snapshot::Operator const op, bool const v) {
+  switch (bits) {
+    default: // never happens
+    case Snapshot::Size::_8:  return kernels<1>(format, op, v);
+    case Snapshot::Size::_16: return kernels<2>(format, op, v);
+    case Snapshot::Size::_24: return kernels<3>(format, op, v);
+    case Snapshot::Size::_32: return kernels<4>(format, op, v);
+  }
+}
+
+Candidates::Candidates(Snapshot const& snapshot) : _snapshot(snapshot) {
+  _count = snapshot.size();
+  _explicit = _count == 0;
+}
+
+bool Candidates::matches(Snapshot const& current) const {
+  return current.address() == _snapshot.address() && current.size() == _snapshot.size();
+}
+
+bool Candidates::filter(Snapshot::Size const bits,
+                        Snapshot::Format const format,
+                        Snapshot::Operator const op,
+                        Snapshot const& current,
+                        std::string* const error) {
+
+  if (!matches(current)) {
+    *error = "The snapshot doesn't cover the same memory as the candidates";
+    return false;
+  }
+
+  filter(bits, format, op, current.data(), 0);
+  _snapshot = current;
+  return true;
+}
+
+void Candidates::filter(Snapshot::Size const bits,
+                        Snapshot::Format const format,
+                        Snapshot::Operator const op,
+                        uint32_t const value) {
+
+  filter(bits, format, op, nullptr, value);
+}
+
+bool Candidates::update(Snapshot const& current, std::string* const error) {
+  if (!matches(current)) {
+    *error = "The snapshot doesn't cover the same memory as the candidates";
+    return false;
+  }
+
+  _snapshot = current;
+  return true;
+}
+
+bool Candidates::contains(uint32_t const address) const {
+  size_t const offset = address - _snapshot.address();
+
+  if (address < _snapshot.address() || offset >= _snapshot.size()) {
+    return false;
+  }
+  else if (_explicit) {
+    return std::binary_search(_offsets.begin(), _offsets.end(), static_cast<uint32_t>(offset));
+  }
+  else if (_bitmap.empty()) {
+    return true;
+  }
+
+  return (_bitmap[offset / 64] >> (offset % 64) & 1) != 0;
+}
+
+Set Candidates::toSet() const {
+  std::vector<uint32_t> elements;
+  elements.reserve(_count);
+
+  uint32_t const address = _snapshot.address();
+
+  if (_explicit) {
+    for (auto const offset : _offsets) {
+      elements.emplace_back(address + offset);
+    }
+  }
+  else if (_bitmap.empty()) {
+    for (size_t offset = 0; offset < _count; offset++) {
+      elements.emplace_back(address + offset);
+    }
+  }
+  else {
+    for (size_t w = 0; w < _bitmap.size(); w++) {
+      uint64_t bits = _bitmap[w];
+
+      while (bits != 0) {
+        elements.emplace_back(address + w * 64 + __builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+  return Set(std::move(elements));
+}
+
+void Candidates::filter(Snapshot::Size const bits,
+                        Snapshot::Format const format,
+                        Snapshot::Operator const op,
+                        uint8_t const* const current,
+                        uint32_t const value) {
+
+  size_t const size = _snapshot.size();
+  size_t const width = sizeOf(bits);
+  size_t const last = size >= width ? size - width + 1 : 0;
+
+  bool const v = current == nullptr;
+  Kernels const k = kernels(bits, format, op, v);
+
+  // data1 is compared against data2, or against value when data2 is null
+  uint8_t const* const data1 = v ? _snapshot.data() : current;
+  uint8_t const* const data2 = v ? nullptr : _snapshot.data();
+
+  if (_explicit) {
+    _count = k.offsets(&_offsets, last, data1, data2, value);
+    return;
+  }
+
+  if (_bitmap.empty()) {
+    // First step, every address is still a candidate
+    _bitmap.assign((size + 63) / 64, ~UINT64_C(0));
+  }
+
+  _count = k.bitmap(_bitmap.data(), _bitmap.size(), last, data1, data2, value);
+  compact();
+}
+
+void Candidates::compact() {
+  if (_count * sizeof(uint32_t) >= _bitmap.size() * sizeof(uint64_t)) {
+    return;
+  }
+
+  _offsets.clear();
+  _offsets.reserve(_count);
+
+  for (size_t w = 0; w < _bitmap.size(); w++) {
+    uint64_t bits = _bitmap[w];
+
+    while (bits != 0) {
+      _offsets.emplace_back(static_cast<uint32_t>(w * 64 + __builtin_ctzll(bits)));
+      bits &= bits - 1;
+    }
+  }
+
+  _bitmap = std::vector<uint64_t>();
+  _explicit = true;
+}
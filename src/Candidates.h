@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Candidates implements the unknown initial value search. The first step only
+ * keeps the snapshot, every address is implicitly a candidate. Subsequent
+ * steps keep one bit per address, and the candidates are moved to an explicit
+ * Set when that becomes smaller than the bitmap.
+ */
+class Candidates
+{
+public:
+  Candidates(Snapshot const& snapshot);
+
+  // Keeps the candidates where the value in current compares to the value in
+  // the previous snapshot, current becomes the previous snapshot. Returns
+  // false and leaves the candidates unchanged if current doesn't cover the
+  // same memory.
+  bool filter(Snapshot::Size const bits,
+              Snapshot::Format const format,
+              Snapshot::Operator const op,
+              Snapshot const& current,
+              std::string* const error);
+
+  // Keeps the candidates where the value in the previous snapshot compares to value.
+  void filter(Snapshot::Size const bits, Snapshot::Format const format, Snapshot::Operator const op, uint32_t const value);
+
+  // Makes current the previous snapshot without filtering, so that the next
+  // filter by value tests the values in current. Fails like filter.
+  bool update(Snapshot const& current, std::string* const error);
+
+  // Whether current covers the same memory as the candidates.
+  bool matches(Snapshot const& current) const;
+
+  Snapshot const& snapshot() const { return _snapshot; }
+  size_t count() const { return _count; }
+  bool isExplicit() const { return _explicit; }
+
+  bool contains(uint32_t const address) const;
+  Set toSet() const;
+
+protected:
+  void filter(Snapshot::Size const bits,
+              Snapshot::Format const format,
+              Snapshot::Operator const op,
+              uint8_t const* const current,
+              uint32_t const value);
+
+  void compact();
+
+  Snapshot              _snapshot;
+  std::vector<uint64_t> _bitmap;
+  std::vector<uint32_t> _offsets;
+  size_t                _count;
+  bool                  _explicit;
+};
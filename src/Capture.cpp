@@ -0,0 +1,563 @@
+#include "Capture.h"
+#include "Value.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
+
+bool Capture::init(Memory* memory, libretro::InputComponent* input)
+{
+  _memory = memory;
+  _input = input;
+  _dropped = 0;
+  _fork = false;
+
+  _type = static_cast<int>(Trigger::Type::Every);
+  snprintf(_label, sizeof(_label), "capture");
+  _frames = 60;
+  _port = 0;
+  _button = RETRO_DEVICE_ID_JOYPAD_SELECT;
+  _address = 0;
+  _bits = static_cast<int>(Snapshot::Size::_8);
+  _format = static_cast<int>(Snapshot::Format::UIntLittleEndian);
+  _operator = static_cast<int>(Snapshot::Operator::Equal);
+  _value = 0;
+
+  _searchBits = static_cast<int>(Snapshot::Size::_8);
+  _searchFormat = static_cast<int>(Snapshot::Format::UIntLittleEndian);
+  _searchOperator = static_cast<int>(Snapshot::Operator::Equal);
+  _searchValue = 0;
+  _searchPending = false;
+
+  return true;
+}
+
+void Capture::destroy()
+{
+  reset();
+  clearTriggers();
+}
+
+void Capture::reset()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _requests.clear();
+  _results.clear();
+  _dropped = 0;
+
+  _searched = Result();
+  _searchPending = false;
+  _found.clear();
+  _values.clear();
+  _status.clear();
+
+  for (auto& armed : _triggers)
+  {
+    armed.previous = false;
+  }
+}
+
+void Capture::request(std::string const& label)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _requests.emplace_back(label);
+}
+
+void Capture::addTrigger(Trigger const& trigger)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  Armed armed;
+  armed.trigger = trigger;
+  armed.previous = false;
+
+  _triggers.emplace_back(armed);
+}
+
+void Capture::removeTrigger(size_t const index)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (index < _triggers.size())
+  {
+    _triggers.erase(_triggers.begin() + index);
+  }
+}
+
+void Capture::clearTriggers()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _triggers.clear();
+}
+
+void Capture::setFork(bool const fork)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _fork = fork && ForkSnapshot::supported();
+}
+
+std::vector<Capture::Result> Capture::take()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  std::vector<Result> results(std::make_move_iterator(_results.begin()), std::make_move_iterator(_results.end()));
+  _results.clear();
+  return results;
+}
+
+void Capture::frame(libretro::CoreManager* const core, uint64_t const frame)
+{
+  (void)core;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<std::string> labels;
+  labels.swap(_requests);
+
+  // Evaluate all triggers even if some capture is already due, to keep their
+  // edge state current
+  for (auto& armed : _triggers)
+  {
+    if (fired(&armed, frame))
+    {
+      labels.emplace_back(armed.trigger.label);
+    }
+  }
+
+  if (labels.empty())
+  {
+    return;
+  }
+
+  std::vector<Snapshot> snapshots;
+  std::shared_ptr<ForkSnapshot> fork;
+
+  if (_fork)
+  {
+    dropForks();
+    fork = std::make_shared<ForkSnapshot>();
+
+    for (auto const& region : _memory->regions())
+    {
+      fork->addRegion(region.address, region.data, region.size);
+    }
+
+    std::string error;
+
+    if (!fork->create(&error))
+    {
+      // Copy the regions instead
+      fork.reset();
+    }
+  }
+
+  if (!fork)
+  {
+    for (auto const& region : _memory->regions())
+    {
+      snapshots.emplace_back(region.address, region.data, region.size);
+    }
+  }
+
+  // Snapshots share their data, so one frame with many labels only copies
+  // the memory once
+  for (auto& label : labels)
+  {
+    if (_results.size() == kMaxResults)
+    {
+      _results.pop_front();
+      _dropped++;
+    }
+
+    Result result;
+    result.frame = frame;
+    result.label = std::move(label);
+    result.snapshots = snapshots;
+    result.fork = fork;
+
+    _results.emplace_back(std::move(result));
+  }
+}
+
+void Capture::dropForks()
+{
+  size_t count = 0;
+
+  for (auto const& result : _results)
+  {
+    count += result.fork ? 1 : 0;
+  }
+
+  for (auto it = _results.begin(); count >= kMaxForks && it != _results.end();)
+  {
+    if (it->fork)
+    {
+      it = _results.erase(it);
+      count--;
+      _dropped++;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+bool Capture::search(Result const& result,
+                     Snapshot::Size const bits,
+                     Snapshot::Format const format,
+                     Snapshot::Operator const op,
+                     uint32_t const value,
+                     std::vector<uint32_t>* const found,
+                     std::string* const error)
+{
+  found->clear();
+
+  if (result.fork)
+  {
+    for (size_t i = 0; i < result.fork->regions().size(); i++)
+    {
+      Set set;
+
+      if (!result.fork->filter(i, bits, format, op, value, &set, error))
+      {
+        return false;
+      }
+
+      found->insert(found->end(), set.begin(), set.end());
+    }
+
+    return true;
+  }
+
+  for (auto const& snapshot : result.snapshots)
+  {
+    Set const set = snapshot.filter(bits, format, op, value);
+    found->insert(found->end(), set.begin(), set.end());
+  }
+
+  return true;
+}
+
+bool Capture::peek(Result const& result, uint32_t const address, size_t const size, uint8_t* const bytes, std::string* const error)
+{
+  if (result.fork)
+  {
+    auto const& regions = result.fork->regions();
+
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+      if (address >= regions[i].address && address - regions[i].address + size <= regions[i].size)
+      {
+        return result.fork->read(i, address - regions[i].address, bytes, size, error);
+      }
+    }
+  }
+  else
+  {
+    for (auto const& snapshot : result.snapshots)
+    {
+      if (address >= snapshot.address() && address - snapshot.address() + size <= snapshot.size())
+      {
+        memcpy(bytes, snapshot.data() + (address - snapshot.address()), size);
+        return true;
+      }
+    }
+  }
+
+  *error = "The address isn't in the capture";
+  return false;
+}
+
+bool Capture::fired(Armed* const armed, uint64_t const frame)
+{
+  Trigger const& trigger = armed->trigger;
+  bool condition = false;
+
+  switch (trigger.type)
+  {
+  case Trigger::Type::Every:
+    return trigger.frames != 0 && frame % trigger.frames == 0;
+
+  case Trigger::Type::Button:
+    condition = _input->read(trigger.port, RETRO_DEVICE_JOYPAD, 0, trigger.button) != 0;
+    break;
+
+  case Trigger::Type::Watch:
+    condition = watch(trigger);
+    break;
+  }
+
+  bool const edge = condition && !armed->previous;
+  armed->previous = condition;
+  return edge;
+}
+
+bool Capture::watch(Trigger const& trigger) const
+{
+  uint32_t value;
+
+  if (!_memory->peek(trigger.address, trigger.bits, trigger.format, &value))
+  {
+    return false;
+  }
+
+  return compare(trigger.op, value, trigger.value);
+}
+
+void Capture::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_CAMERA " Captures"))
+  {
+    if (ImGui::Button(ICON_FA_CAMERA " Capture") && running)
+    {
+      request(_label);
+    }
+
+    ImGui::SameLine();
+    ImGui::InputText("Label", _label, sizeof(_label));
+
+    if (ForkSnapshot::supported())
+    {
+      bool fork = _fork;
+
+      if (ImGui::Checkbox("Fork instead of copying", &fork))
+      {
+        setFork(fork);
+      }
+    }
+
+    ImGui::Separator();
+    drawTriggers();
+    ImGui::Separator();
+    drawResults();
+  }
+
+  ImGui::End();
+}
+
+void Capture::drawTriggers()
+{
+  static char const* const types[] = {"Every N frames", "Button press", "Watch"};
+  static char const* const buttons[] = {"B", "Y", "Select", "Start", "Up", "Down", "Left", "Right", "A", "X", "L", "R", "L2", "R2", "L3", "R3"};
+  static char const* const sizes[] = {"8 bits", "16 bits", "24 bits", "32 bits"};
+  static char const* const formats[] = {"Little endian", "Big endian", "BCD little endian", "BCD big endian"};
+  static char const* const operators[] = {"<", "<=", ">", ">=", "==", "!="};
+
+  ImGui::Combo("Trigger", &_type, types, IM_ARRAYSIZE(types));
+
+  switch (static_cast<Trigger::Type>(_type))
+  {
+  case Trigger::Type::Every:
+    ImGui::InputInt("Frames", &_frames);
+    break;
+
+  case Trigger::Type::Button:
+    ImGui::InputInt("Port", &_port);
+    ImGui::Combo("Button", &_button, buttons, IM_ARRAYSIZE(buttons));
+    break;
+
+  case Trigger::Type::Watch:
+    ImGui::InputInt("Address", &_address, 1, 16, ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::Combo("Size", &_bits, sizes, IM_ARRAYSIZE(sizes));
+    ImGui::Combo("Format", &_format, formats, IM_ARRAYSIZE(formats));
+    ImGui::Combo("Operator", &_operator, operators, IM_ARRAYSIZE(operators));
+    ImGui::InputInt("Value", &_value);
+    break;
+  }
+
+  if (ImGui::Button(ICON_FA_PLUS " Add trigger"))
+  {
+    Trigger trigger;
+    trigger.type = static_cast<Trigger::Type>(_type);
+    trigger.label = _label;
+    trigger.frames = _frames > 0 ? _frames : 1;
+    trigger.port = _port > 0 ? _port : 0;
+    trigger.button = _button;
+    trigger.address = _address;
+    trigger.bits = static_cast<Snapshot::Size>(_bits);
+    trigger.format = static_cast<Snapshot::Format>(_format);
+    trigger.op = static_cast<Snapshot::Operator>(_operator);
+    trigger.value = _value;
+
+    addTrigger(trigger);
+  }
+
+  size_t remove = ~static_cast<size_t>(0);
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (size_t i = 0; i < _triggers.size(); i++)
+    {
+      Trigger const& trigger = _triggers[i].trigger;
+
+      ImGui::PushID(static_cast<int>(i));
+
+      if (ImGui::Button(ICON_FA_TIMES))
+      {
+        remove = i;
+      }
+
+      ImGui::SameLine();
+
+      switch (trigger.type)
+      {
+      case Trigger::Type::Every:
+        ImGui::Text("%s: every %u frames", trigger.label.c_str(), trigger.frames);
+        break;
+
+      case Trigger::Type::Button:
+        ImGui::Text("%s: port %u, %s pressed", trigger.label.c_str(), trigger.port, trigger.button < IM_ARRAYSIZE(buttons) ? buttons[trigger.button] : "?");
+        break;
+
+      case Trigger::Type::Watch:
+        ImGui::Text("%s: [%08X] %s %u", trigger.label.c_str(), trigger.address, operators[static_cast<int>(trigger.op)], trigger.value);
+        break;
+      }
+
+      ImGui::PopID();
+    }
+  }
+
+  removeTrigger(remove);
+}
+
+void Capture::drawResults()
+{
+  static char const* const sizes[] = {"8 bits", "16 bits", "24 bits", "32 bits"};
+  static char const* const formats[] = {"Little endian", "Big endian", "BCD little endian", "BCD big endian"};
+  static char const* const operators[] = {"<", "<=", ">", ">=", "==", "!="};
+
+  bool clear;
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    clear = ImGui::Button(ICON_FA_TRASH " Clear");
+
+    ImGui::SameLine();
+    ImGui::Text("%zu captures, %llu dropped", _results.size(), static_cast<unsigned long long>(_dropped));
+
+    ImGui::Combo("Search size", &_searchBits, sizes, IM_ARRAYSIZE(sizes));
+    ImGui::Combo("Search format", &_searchFormat, formats, IM_ARRAYSIZE(formats));
+    ImGui::Combo("Search operator", &_searchOperator, operators, IM_ARRAYSIZE(operators));
+    ImGui::InputInt("Search value", &_searchValue);
+
+    for (size_t i = 0; i < _results.size(); i++)
+    {
+      Result const& result = _results[i];
+      unsigned long long const frame = result.frame;
+
+      ImGui::PushID(static_cast<int>(i));
+
+      if (ImGui::Button(ICON_FA_SEARCH " Search"))
+      {
+        // Searching a fork waits for the forked process, so it runs in
+        // runSearch once the emulation thread can go on; snapshots and
+        // forks are shared, not copied
+        _searched = result;
+        _searchPending = true;
+      }
+
+      ImGui::PopID();
+      ImGui::SameLine();
+
+      if (result.fork)
+      {
+        ImGui::Text("Frame %llu: %s, forked", frame, result.label.c_str());
+        continue;
+      }
+
+      size_t bytes = 0;
+
+      for (auto const& snapshot : result.snapshots)
+      {
+        bytes += snapshot.size();
+      }
+
+      ImGui::Text("Frame %llu: %s, %zu bytes", frame, result.label.c_str(), bytes);
+    }
+  }
+
+  drawFound();
+
+  if (clear)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _results.clear();
+    _dropped = 0;
+  }
+}
+
+void Capture::runSearch()
+{
+  if (!_searchPending)
+  {
+    return;
+  }
+
+  _searchPending = false;
+
+  Result const& result = _searched;
+  auto const bits = static_cast<Snapshot::Size>(_searchBits);
+  auto const format = static_cast<Snapshot::Format>(_searchFormat);
+  std::string error;
+
+  _values.clear();
+
+  if (search(result, bits, format, static_cast<Snapshot::Operator>(_searchOperator), _searchValue, &_found, &error))
+  {
+    size_t const count = std::min(_found.size(), static_cast<size_t>(kMaxShown));
+    size_t const size = sizeOf(bits);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      uint8_t bytes[4];
+
+      if (!peek(result, _found[i], size, bytes, &error))
+      {
+        break;
+      }
+
+      _values.emplace_back(read(bits, format, bytes));
+    }
+
+    char status[128];
+    snprintf(status, sizeof(status), "%zu addresses in frame %llu", _found.size(), static_cast<unsigned long long>(result.frame));
+    _status = status;
+  }
+  else
+  {
+    _found.clear();
+    _status = error;
+  }
+
+  // Don't keep the fork alive once its capture is cleared
+  _searched = Result();
+}
+
+void Capture::drawFound()
+{
+  if (_status.empty())
+  {
+    return;
+  }
+
+  ImGui::Separator();
+  ImGui::TextUnformatted(_status.c_str());
+
+  for (size_t i = 0; i < _values.size(); i++)
+  {
+    ImGui::Text("%08X: %u", _found[i], _values[i]);
+  }
+
+  if (_found.size() > _values.size())
+  {
+    ImGui::Text("%zu more", _found.size() - _values.size());
+  }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include "ForkSnapshot.h"
+#include "Memory.h"
+#include "Snapshot.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Capture takes snapshots of all memory regions right after a frame has run,
+ * so that each capture is consistent no matter when it was asked for. Captures
+ * are either requested, or fired by triggers: every N frames, on a button
+ * press, or when a watched value starts to satisfy a condition.
+ *
+ * On Linux, captures can fork the process instead of copying the regions,
+ * see ForkSnapshot. Searches in a forked capture run in the forked process,
+ * its memory is never copied back.
+ */
+class Capture : public libretro::FrameListener
+{
+public:
+  struct Trigger
+  {
+    enum class Type
+    {
+      Every,
+      Button,
+      Watch
+    };
+
+    Type        type;
+    std::string label;
+
+    // Every
+    unsigned frames;
+
+    // Button, RETRO_DEVICE_ID_JOYPAD_*
+    unsigned port;
+    unsigned button;
+
+    // Watch
+    uint32_t           address;
+    Snapshot::Size     bits;
+    Snapshot::Format   format;
+    Snapshot::Operator op;
+    uint32_t           value;
+  };
+
+  struct Result
+  {
+    uint64_t              frame;
+    std::string           label;
+    // Empty when the capture was forked.
+    std::vector<Snapshot> snapshots;
+    std::shared_ptr<ForkSnapshot> fork;
+  };
+
+  bool init(Memory* memory, libretro::InputComponent* input);
+  void destroy();
+  void draw(bool running);
+
+  void reset();
+
+  // Captures at the end of the next frame.
+  void request(std::string const& label);
+
+  void addTrigger(Trigger const& trigger);
+  void removeTrigger(size_t const index);
+  void clearTriggers();
+
+  void setFork(bool const fork);
+
+  // Moves the results out, oldest first.
+  std::vector<Result> take();
+
+  // Finds the addresses where the value in the capture satisfies the
+  // condition, in the forked process if the capture was forked.
+  static bool search(Result const& result,
+                     Snapshot::Size const bits,
+                     Snapshot::Format const format,
+                     Snapshot::Operator const op,
+                     uint32_t const value,
+                     std::vector<uint32_t>* const found,
+                     std::string* const error);
+
+  // Runs the search asked for in the window. Must be called on the UI
+  // thread without holding the emulation lock, since searching a forked
+  // capture waits for the forked process.
+  void runSearch();
+
+  virtual void frame(libretro::CoreManager* const core, uint64_t const frame) override;
+
+protected:
+  enum
+  {
+    kMaxResults = 64,
+    // Found addresses listed with their values
+    kMaxShown = 64,
+    // Each fork keeps a process alive, holding a copy of every page written
+    // since it was taken
+    kMaxForks = 8
+  };
+
+  struct Armed
+  {
+    Trigger trigger;
+    // The condition at the previous frame, so that Button and Watch only fire
+    // on the edge and not for as long as the condition holds.
+    bool    previous;
+  };
+
+  void dropForks();
+  bool fired(Armed* const armed, uint64_t const frame);
+  // False if the address isn't in any region.
+  bool watch(Trigger const& trigger) const;
+  static bool peek(Result const& result, uint32_t const address, size_t const size, uint8_t* const bytes, std::string* const error);
+
+  void drawTriggers();
+  void drawResults();
+  void drawFound();
+
+  Memory*                   _memory;
+  libretro::InputComponent* _input;
+
+  // frame() runs on the emulation thread, the public functions can be called
+  // from any thread
+  std::mutex               _mutex;
+  std::vector<std::string> _requests;
+  std::vector<Armed>       _triggers;
+  std::deque<Result>       _results;
+  uint64_t                 _dropped;
+  bool                     _fork;
+
+  int  _type;
+  char _label[64];
+  int  _frames;
+  int  _port;
+  int  _button;
+  int  _address;
+  int  _bits;
+  int  _format;
+  int  _operator;
+  int  _value;
+
+  // Searches, owned by the UI thread
+  Result                _searched;
+  bool                  _searchPending;
+  int                   _searchBits;
+  int                   _searchFormat;
+  int                   _searchOperator;
+  int                   _searchValue;
+  std::vector<uint32_t> _found;
+  std::vector<uint32_t> _values;
+  std::string           _status;
+};
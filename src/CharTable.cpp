@@ -0,0 +1,142 @@
+#include "CharTable.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static int hexDigit(char const c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
+
+bool CharTable::load(std::string const& path, std::string* const error) {
+  FILE* const file = fopen(path.c_str(), "rb");
+
+  if (file == NULL) {
+    if (error != nullptr) {
+      *error = strerror(errno);
+    }
+
+    return false;
+  }
+
+  std::string contents;
+  char buffer[4096];
+  size_t numRead;
+
+  while ((numRead = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+    contents.append(buffer, numRead);
+  }
+
+  fclose(file);
+  return parse(contents.c_str(), contents.size(), error);
+}
+
+bool CharTable::parse(char const* const data, size_t const size, std::string* const error) {
+  _entries.clear();
+
+  char const* line = data;
+  char const* const end = data + size;
+  unsigned lineNumber = 0;
+
+  while (line < end) {
+    char const* eol = line;
+
+    while (eol < end && *eol != '\n') {
+      eol++;
+    }
+
+    char const* next = eol + 1;
+    lineNumber++;
+
+    if (eol > line && eol[-1] == '\r') {
+      eol--;
+    }
+
+    if (eol == line || strchr("#;/*", *line) != nullptr) {
+      line = next;
+      continue;
+    }
+
+    char const* const equal = static_cast<char const*>(memchr(line, '=', eol - line));
+
+    if (equal == nullptr || equal == line || (equal - line) % 2 != 0 || equal + 1 == eol) {
+      goto error;
+    }
+
+    {
+      Entry entry;
+
+      for (char const* digit = line; digit < equal; digit += 2) {
+        int const high = hexDigit(digit[0]);
+        int const low = hexDigit(digit[1]);
+
+        if (high < 0 || low < 0) {
+          goto error;
+        }
+
+        entry.bytes.emplace_back(static_cast<uint8_t>(high << 4 | low));
+      }
+
+      entry.text.assign(equal + 1, eol);
+      _entries.emplace_back(std::move(entry));
+    }
+
+    line = next;
+  }
+
+  // Longer texts first so that encode always picks the longest match
+  std::stable_sort(_entries.begin(), _entries.end(), [](Entry const& a, Entry const& b) -> bool {
+    return a.text.length() > b.text.length();
+  });
+
+  return true;
+
+error:
+  if (error != nullptr) {
+    char message[64];
+    snprintf(message, sizeof(message), "Invalid table entry in line %u", lineNumber);
+    *error = message;
+  }
+
+  _entries.clear();
+  return false;
+}
+
+bool CharTable::encode(std::string const& text, std::vector<uint8_t>* const bytes, std::string* const error) const {
+  bytes->clear();
+
+  for (size_t pos = 0; pos < text.length();) {
+    Entry const* found = nullptr;
+
+    for (auto const& entry : _entries) {
+      if (text.compare(pos, entry.text.length(), entry.text) == 0) {
+        found = &entry;
+        break;
+      }
+    }
+
+    if (found == nullptr) {
+      if (error != nullptr) {
+        *error = "No table entry for \"" + text.substr(pos, 1) + "\"";
+      }
+
+      return false;
+    }
+
+    bytes->insert(bytes->end(), found->bytes.begin(), found->bytes.end());
+    pos += found->text.length();
+  }
+
+  return true;
+}
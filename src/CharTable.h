@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * CharTable maps byte sequences to text, as found in .tbl files used to
+ * translate games. Each line has the form HEX=text, i.e. 8A=A or 0102=the.
+ * Blank lines and lines starting with #, ;, / or * are ignored.
+ */
+class CharTable
+{
+public:
+  bool load(std::string const& path, std::string* const error);
+  bool parse(char const* const data, size_t const size, std::string* const error);
+
+  // Encodes text into bytes, always using the longest match.
+  bool encode(std::string const& text, std::vector<uint8_t>* const bytes, std::string* const error) const;
+
+protected:
+  struct Entry
+  {
+    std::vector<uint8_t> bytes;
+    std::string          text;
+  };
+
+  std::vector<Entry> _entries;
+};
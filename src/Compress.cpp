@@ -0,0 +1,176 @@
+#include "Compress.h"
+
+#include <stdint.h>
+#include <string.h>
+
+enum {
+  kMinMatch = 4,
+  kMaxOffset = 65535,
+  kHashBits = 12
+};
+
+static inline uint32_t read32(uint8_t const* const p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint8_t* putLength(uint8_t* out, size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+
+  *out++ = static_cast<uint8_t>(length);
+  return out;
+}
+
+static inline bool getLength(uint8_t const** const in, uint8_t const* const end, size_t* const length) {
+  uint8_t byte;
+
+  do {
+    if (*in == end) {
+      return false;
+    }
+
+    byte = *(*in)++;
+    *length += byte;
+  }
+  while (byte == 255);
+
+  return true;
+}
+
+static uint8_t* putSequence(uint8_t* out, uint8_t const* const literals, size_t const count, size_t const offset, size_t const length) {
+  // A length of 0 is the last sequence, which has no match
+  size_t const match = length != 0 ? length - kMinMatch : 0;
+  *out++ = static_cast<uint8_t>((count < 15 ? count : 15) << 4 | (match < 15 ? match : 15));
+
+  if (count >= 15) {
+    out = putLength(out, count - 15);
+  }
+
+  if (count != 0) {
+    memcpy(out, literals, count);
+    out += count;
+  }
+
+  if (length != 0) {
+    *out++ = static_cast<uint8_t>(offset);
+    *out++ = static_cast<uint8_t>(offset >> 8);
+
+    if (match >= 15) {
+      out = putLength(out, match - 15);
+    }
+  }
+
+  return out;
+}
+
+size_t compressBound(size_t const size) {
+  return size + size / 255 + 16;
+}
+
+size_t compress(void const* const data, size_t const size, void* const out) {
+  uint8_t const* const in = static_cast<uint8_t const*>(data);
+  uint8_t* const begin = static_cast<uint8_t*>(out);
+  uint8_t* op = begin;
+
+  // Positions of the last sequence of 4 bytes with each hash; a stale or
+  // colliding position is caught by comparing the bytes
+  uint32_t table[1 << kHashBits];
+  memset(table, 0, sizeof(table));
+
+  size_t anchor = 0;
+  size_t i = 1;
+
+  while (size >= kMinMatch && i <= size - kMinMatch) {
+    uint32_t const sequence = read32(in + i);
+    uint32_t const hash = (sequence * UINT32_C(2654435761)) >> (32 - kHashBits);
+    size_t const candidate = table[hash];
+    table[hash] = static_cast<uint32_t>(i);
+
+    if (i - candidate > kMaxOffset || read32(in + candidate) != sequence) {
+      // Step faster over data that doesn't compress
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+
+    size_t length = kMinMatch;
+
+    while (i + length < size && in[candidate + length] == in[i + length]) {
+      length++;
+    }
+
+    op = putSequence(op, in + anchor, i - anchor, i - candidate, length);
+    i += length;
+    anchor = i;
+  }
+
+  op = putSequence(op, in + anchor, size - anchor, 0, 0);
+  return op - begin;
+}
+
+bool decompress(void const* const data, size_t const size, void* const out, size_t const outSize) {
+  uint8_t const* ip = static_cast<uint8_t const*>(data);
+  uint8_t const* const end = ip + size;
+  uint8_t* const begin = static_cast<uint8_t*>(out);
+  uint8_t* op = begin;
+  uint8_t* const outEnd = begin + outSize;
+
+  while (ip < end) {
+    uint8_t const token = *ip++;
+    size_t count = token >> 4;
+
+    if (count == 15 && !getLength(&ip, end, &count)) {
+      return false;
+    }
+
+    if (static_cast<size_t>(end - ip) < count || static_cast<size_t>(outEnd - op) < count) {
+      return false;
+    }
+
+    if (count != 0) {
+      memcpy(op, ip, count);
+      ip += count;
+      op += count;
+    }
+
+    if (ip == end) {
+      // The last sequence
+      break;
+    }
+
+    if (end - ip < 2) {
+      return false;
+    }
+
+    size_t const offset = ip[0] | ip[1] << 8;
+    ip += 2;
+
+    size_t length = token & 15;
+
+    if (length == 15 && !getLength(&ip, end, &length)) {
+      return false;
+    }
+
+    length += kMinMatch;
+
+    if (offset == 0 || offset > static_cast<size_t>(op - begin) || static_cast<size_t>(outEnd - op) < length) {
+      return false;
+    }
+
+    // The match can overlap the bytes it writes; what's between the match
+    // and op repeats with the right period, and doubles with each copy
+    uint8_t const* const match = op - offset;
+
+    while (length != 0) {
+      size_t const chunk = static_cast<size_t>(op - match) < length ? op - match : length;
+      memcpy(op, match, chunk);
+      op += chunk;
+      length -= chunk;
+    }
+  }
+
+  return op == outEnd;
+}
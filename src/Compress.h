@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+// Byte-oriented LZ77 in the LZ4 block layout: each sequence is a token with
+// the number of literals and the match length minus 4 in its nibbles, 255
+// bytes extending either when it's 15, the literals, and the match offset
+// as a little endian uint16_t. The last sequence only has literals. Fast
+// more than small, meant for savestates which are mostly zeros and tables.
+
+// The most bytes that compressing size bytes can take.
+size_t compressBound(size_t const size);
+
+// Returns the number of bytes written to out, which must have room for
+// compressBound(size) bytes.
+size_t compress(void const* const data, size_t const size, void* const out);
+
+// Returns false if the data is corrupted or doesn't decompress to exactly
+// size bytes.
+bool decompress(void const* const data, size_t const size, void* const out, size_t const outSize);
@@ -0,0 +1,192 @@
+#include "Correlation.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <algorithm>
+#include <math.h>
+
+bool Correlation::init(FrameDiff* diff, Video* video)
+{
+  _diff = diff;
+  _video = video;
+  _rect[0] = _rect[1] = _rect[2] = _rect[3] = 0;
+  reset();
+  return true;
+}
+
+void Correlation::destroy()
+{
+  reset();
+}
+
+void Correlation::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_LINE_CHART " Correlation"))
+  {
+    if (ImGui::InputInt4("Rectangle", _rect))
+    {
+      for (unsigned i = 0; i < 4; i++)
+      {
+        _rect[i] = std::max(_rect[i], 0);
+      }
+
+      _video->setWatch(_rect[0], _rect[1], _rect[2], _rect[3]);
+    }
+
+    if (!_running)
+    {
+      if (ImGui::Button(ICON_FA_PLAY " Start") && running)
+      {
+        start();
+      }
+    }
+    else if (ImGui::Button(ICON_FA_STOP " Stop"))
+    {
+      stop();
+    }
+
+    ImGui::SameLine();
+
+    if (ImGui::Button(ICON_FA_SORT_AMOUNT_DESC " Rank"))
+    {
+      _ranking = rank(256);
+    }
+
+    ImGui::Text("%u frames, the rectangle changed in %u", _frames, _screenFrames);
+
+    ImGui::Columns(4, "correlation", true);
+    ImGui::Separator();
+    ImGui::Text("Address"); ImGui::NextColumn();
+    ImGui::Text("Score"); ImGui::NextColumn();
+    ImGui::Text("Changes"); ImGui::NextColumn();
+    ImGui::Text("Matches"); ImGui::NextColumn();
+
+    for (auto const& score : _ranking)
+    {
+      ImGui::Separator();
+      ImGui::Text("%08X", score.address); ImGui::NextColumn();
+      ImGui::Text("%.3f", score.score); ImGui::NextColumn();
+      ImGui::Text("%u", score.changes); ImGui::NextColumn();
+      ImGui::Text("%u", score.matches); ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+    ImGui::Separator();
+  }
+
+  ImGui::End();
+}
+
+void Correlation::start()
+{
+  reset();
+
+  for (auto const& region : _diff->regions())
+  {
+    Region tracked;
+    tracked.address = region.address;
+    tracked.changes.assign(region.size, 0);
+    tracked.matches.assign(region.size, 0);
+
+    _regions.emplace_back(std::move(tracked));
+  }
+
+  // Discard any change that happened before starting
+  _video->watchChanged();
+  _running = true;
+}
+
+void Correlation::stop()
+{
+  _running = false;
+}
+
+void Correlation::reset()
+{
+  _regions.clear();
+  _ranking.clear();
+  _running = false;
+  _frames = 0;
+  _screenFrames = 0;
+}
+
+void Correlation::update()
+{
+  if (!_running)
+  {
+    return;
+  }
+
+  bool const screen = _video->watchChanged();
+
+  _frames++;
+  _screenFrames += screen;
+
+  for (auto const& change : _diff->changes())
+  {
+    if (change.region >= _regions.size())
+    {
+      continue;
+    }
+
+    Region& region = _regions[change.region];
+    size_t const offset = change.address - region.address;
+
+    if (offset + change.length > region.changes.size())
+    {
+      continue;
+    }
+
+    for (unsigned i = 0; i < change.length; i++)
+    {
+      region.changes[offset + i]++;
+      region.matches[offset + i] += screen;
+    }
+  }
+}
+
+std::vector<Correlation::Score> Correlation::rank(size_t const max) const
+{
+  std::vector<Score> scores;
+
+  double const frames = _frames;
+  double const screen = _screenFrames;
+
+  for (auto const& region : _regions)
+  {
+    for (size_t i = 0; i < region.changes.size(); i++)
+    {
+      uint32_t const changes = region.changes[i];
+
+      if (changes == 0)
+      {
+        continue;
+      }
+
+      // Phi coefficient of the 2x2 table of RAM and screen changes
+      double const n11 = region.matches[i];
+      double const n10 = changes - n11;
+      double const n01 = screen - n11;
+      double const n00 = frames - n11 - n10 - n01;
+      double const den = (n11 + n10) * (n01 + n00) * (n11 + n01) * (n10 + n00);
+
+      Score score;
+      score.address = region.address + i;
+      score.score = den > 0.0 ? (n11 * n00 - n10 * n01) / sqrt(den) : 0.0;
+      score.changes = changes;
+      score.matches = region.matches[i];
+
+      scores.emplace_back(score);
+    }
+  }
+
+  size_t const count = std::min(max, scores.size());
+
+  std::partial_sort(scores.begin(), scores.begin() + count, scores.end(), [](Score const& a, Score const& b) -> bool {
+    return a.score > b.score;
+  });
+
+  scores.resize(count);
+  return scores;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "FrameDiff.h"
+#include "components/Video.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Correlation looks for addresses whose changes line up with the changes of
+ * a rectangle of the video output, like a score counter or a health bar.
+ */
+class Correlation
+{
+public:
+  struct Score
+  {
+    uint32_t address;
+    double   score;
+    uint32_t changes;
+    uint32_t matches;
+  };
+
+  bool init(FrameDiff* diff, Video* video);
+  void destroy();
+  void draw(bool running);
+
+  void start();
+  void stop();
+  void reset();
+
+  // Must be called once per frame, after the frame diff has been updated.
+  void update();
+
+  std::vector<Score> rank(size_t const max) const;
+
+protected:
+  struct Region
+  {
+    uint32_t              address;
+    std::vector<uint32_t> changes;
+    std::vector<uint32_t> matches;
+  };
+
+  FrameDiff* _diff;
+  Video*     _video;
+
+  std::vector<Region> _regions;
+  std::vector<Score>  _ranking;
+  bool                _running;
+  uint32_t            _frames;
+  uint32_t            _screenFrames;
+  int                 _rect[4];
+};
@@ -0,0 +1,115 @@
+#include "DirtyPages.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static uint64_t const kSoftDirty = UINT64_C(1) << 55;
+
+DirtyPages::DirtyPages() : _pagemap(-1), _clearRefs(-1), _pageSize(4096) {}
+
+DirtyPages::~DirtyPages() {
+  destroy();
+}
+
+bool DirtyPages::init() {
+#ifdef __linux__
+  _pageSize = sysconf(_SC_PAGESIZE);
+  _pagemap = open("/proc/self/pagemap", O_RDONLY);
+  _clearRefs = open("/proc/self/clear_refs", O_WRONLY);
+
+  if (_pagemap < 0 || _clearRefs < 0) {
+    destroy();
+    return false;
+  }
+
+  // The files exist even when the kernel is built without soft-dirty
+  // support, so check that a write to a page is actually detected
+  void* const page = mmap(nullptr, _pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (page == MAP_FAILED) {
+    destroy();
+    return false;
+  }
+
+  volatile uint8_t* const byte = static_cast<uint8_t*>(page);
+  std::vector<uint64_t> bits;
+
+  *byte = 1;
+  bool ok = clear() && query(page, 1, &bits) && bits[0] == 0;
+
+  *byte = 2;
+  ok = ok && query(page, 1, &bits) && bits[0] == 1;
+
+  munmap(page, _pageSize);
+
+  if (!ok) {
+    destroy();
+    return false;
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void DirtyPages::destroy() {
+#ifdef __linux__
+  if (_pagemap >= 0) {
+    close(_pagemap);
+  }
+
+  if (_clearRefs >= 0) {
+    close(_clearRefs);
+  }
+#endif
+
+  _pagemap = -1;
+  _clearRefs = -1;
+}
+
+bool DirtyPages::clear() {
+#ifdef __linux__
+  return _clearRefs >= 0 && pwrite(_clearRefs, "4", 1, 0) == 1;
+#else
+  return false;
+#endif
+}
+
+bool DirtyPages::query(void const* const data, size_t const size, std::vector<uint64_t>* const bits) {
+  uintptr_t const first = reinterpret_cast<uintptr_t>(data) / _pageSize;
+  uintptr_t const last = (reinterpret_cast<uintptr_t>(data) + size + _pageSize - 1) / _pageSize;
+  size_t const count = last - first;
+
+  bits->assign((count + 63) / 64, 0);
+
+#ifdef __linux__
+  if (_pagemap < 0) {
+    return false;
+  }
+
+  uint64_t entries[512];
+
+  for (size_t page = 0; page < count; page += 512) {
+    size_t const batch = count - page < 512 ? count - page : 512;
+    off_t const offset = static_cast<off_t>((first + page) * sizeof(uint64_t));
+
+    if (pread(_pagemap, entries, batch * sizeof(uint64_t), offset) != static_cast<ssize_t>(batch * sizeof(uint64_t))) {
+      return false;
+    }
+
+    for (size_t i = 0; i < batch; i++) {
+      if ((entries[i] & kSoftDirty) != 0) {
+        (*bits)[(page + i) / 64] |= UINT64_C(1) << ((page + i) % 64);
+      }
+    }
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * DirtyPages uses the soft-dirty bits of Linux to find out which host pages
+ * were written since the last clear. Clearing write-protects every page of
+ * the process, so the first write to each page after a clear costs a minor
+ * fault. init returns false where this is unsupported, and users must then
+ * assume that all pages were written. The bits are shared by the whole
+ * process, so only one instance should be active at a time.
+ */
+class DirtyPages
+{
+public:
+  DirtyPages();
+  ~DirtyPages();
+
+  bool init();
+  void destroy();
+
+  bool active() const { return _pagemap >= 0; }
+  size_t pageSize() const { return _pageSize; }
+
+  // Clears the soft-dirty bits of all pages of the process.
+  bool clear();
+
+  // Sets one bit per page written since the last clear, for the pages that
+  // overlap [data, data + size), starting with the page containing data.
+  bool query(void const* const data, size_t const size, std::vector<uint64_t>* const bits);
+
+protected:
+  int    _pagemap;
+  int    _clearRefs;
+  size_t _pageSize;
+};
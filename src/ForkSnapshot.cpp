@@ -0,0 +1,411 @@
+#include "ForkSnapshot.h"
+#include "Value.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  enum : uint32_t {
+    kFilter,
+    kRead
+  };
+
+  // Filter results are sent in batches of at most this many addresses,
+  // each one preceded by its count, and an empty batch ends the result
+  enum : uint32_t {
+    kBatchSize = 1024
+  };
+}
+
+#ifdef __linux__
+static bool sendAll(int const fd, void const* const data, size_t const size) {
+  auto bytes = static_cast<uint8_t const*>(data);
+  size_t left = size;
+
+  while (left != 0) {
+    // MSG_NOSIGNAL so that a dead child doesn't kill us with SIGPIPE
+    ssize_t const sent = send(fd, bytes, left, MSG_NOSIGNAL);
+
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    else if (sent <= 0) {
+      return false;
+    }
+
+    bytes += sent;
+    left -= sent;
+  }
+
+  return true;
+}
+
+static bool receiveAll(int const fd, void* const data, size_t const size) {
+  auto bytes = static_cast<uint8_t*>(data);
+  size_t left = size;
+
+  while (left != 0) {
+    ssize_t const received = recv(fd, bytes, left, 0);
+
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    else if (received <= 0) {
+      return false;
+    }
+
+    bytes += received;
+    left -= received;
+  }
+
+  return true;
+}
+
+// Runs in the child, so it only uses the stack: the matches are sent a
+// batch at a time from a fixed buffer.
+template<size_t S, Snapshot::Format F, Snapshot::Operator O>
+static bool sendMatches(int const fd, uint32_t const address, uint8_t const* const bytes, size_t const size, uint32_t const value) {
+  uint32_t batch[kBatchSize + 1];
+  uint32_t count = 0;
+
+  for (size_t i = 0; i + S <= size; i++) {
+    if (compare<O>(read<S, F>(bytes + i), value)) {
+      batch[++count] = address + i;
+
+      if (count == kBatchSize) {
+        batch[0] = count;
+
+        if (!sendAll(fd, batch, (count + 1) * sizeof(uint32_t))) {
+          return false;
+        }
+
+        count = 0;
+      }
+    }
+  }
+
+  if (count != 0) {
+    batch[0] = count;
+
+    if (!sendAll(fd, batch, (count + 1) * sizeof(uint32_t))) {
+      return false;
+    }
+  }
+
+  uint32_t const end = 0;
+  return sendAll(fd, &end, sizeof(end));
+}
+
+typedef bool (*SendMatches)(int const, uint32_t const, uint8_t const* const, size_t const, uint32_t const);
+
+template<size_t S, Snapshot::Format F>
+static SendMatches sendMatches(Snapshot::Operator const op) {
+  switch (op) {
+    default: // never happens
+    case Snapshot::Operator::LessThan:     return sendMatches<S, F, Snapshot::Operator::LessThan>;
+    case Snapshot::Operator::LessEqual:    return sendMatches<S, F, Snapshot::Operator::LessEqual>;
+    case Snapshot::Operator::GreaterThan:  return sendMatches<S, F, Snapshot::Operator::GreaterThan>;
+    case Snapshot::Operator::GreaterEqual: return sendMatches<S, F, Snapshot::Operator::GreaterEqual>;
+    case Snapshot::Operator::Equal:        return sendMatches<S, F, Snapshot::Operator::Equal>;
+    case Snapshot::Operator::NotEqual:     return sendMatches<S, F, Snapshot::Operator::NotEqual>;
+  }
+}
+
+template<size_t S>
+static SendMatches sendMatches(Snapshot::Format const format, Snapshot::Operator const op) {
+  switch (format) {
+    default: // never happens
+    case Snapshot::Format::UIntLittleEndian: return sendMatches<S, Snapshot::Format::UIntLittleEndian>(op);
+    case Snapshot::Format::UIntBigEndian:    return sendMatches<S, Snapshot::Format::UIntBigEndian>(op);
+    case Snapshot::Format::BCDLittleEndian:  return sendMatches<S, Snapshot::Format::BCDLittleEndian>(op);
+    case Snapshot::Format::BCDBigEndian:     return sendMatches<S, Snapshot::Format::BCDBigEndian>(op);
+  }
+}
+
+static SendMatches sendMatches(Snapshot::Size const bits, Snapshot::Format const format, Snapshot::Operator const op) {
+  switch (bits) {
+    default: // never happens
+    case Snapshot::Size::_8:  return sendMatches<1>(format, op);
+    case Snapshot::Size::_16: return sendMatches<2>(format, op);
+    case Snapshot::Size::_24: return sendMatches<3>(format, op);
+    case Snapshot::Size::_32: return sendMatches<4>(format, op);
+  }
+}
+#endif
+
+ForkSnapshot::ForkSnapshot() : _pid(-1), _socket(-1) {}
+
+ForkSnapshot::~ForkSnapshot() {
+  destroy();
+}
+
+bool ForkSnapshot::supported() {
+#ifdef __linux__
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ForkSnapshot::addRegion(uint32_t const address, void const* const data, size_t const size) {
+  Region region;
+  region.address = address;
+  region.data = data;
+  region.size = size;
+
+  _regions.emplace_back(region);
+}
+
+bool ForkSnapshot::create(std::string* const error) {
+#ifdef __linux__
+  destroy();
+
+  int fds[2];
+
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    *error = std::string("socketpair: ") + strerror(errno);
+    return false;
+  }
+
+  pid_t const parent = getpid();
+  pid_t const pid = fork();
+
+  if (pid < 0) {
+    *error = std::string("fork: ") + strerror(errno);
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  else if (pid == 0) {
+    // Only the thread that called fork exists in the child, so it must not
+    // touch anything that other threads could have left locked, the heap
+    // included, and it must leave with _exit to skip the parent's atexit
+    // handlers and buffers
+    close(fds[0]);
+    _socket = fds[1];
+
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) != 0 || getppid() != parent) {
+      _exit(1);
+    }
+
+    serve();
+    _exit(0);
+  }
+
+  close(fds[1]);
+  _socket = fds[0];
+  _pid = pid;
+  return true;
+#else
+  *error = "Fork snapshots are only available on Linux";
+  return false;
+#endif
+}
+
+void ForkSnapshot::destroy() {
+#ifdef __linux__
+  if (_socket >= 0) {
+    close(_socket);
+    _socket = -1;
+  }
+
+  if (_pid > 0) {
+    // Other children may have inherited our end of the socket, so closing it
+    // isn't guaranteed to end the child
+    kill(_pid, SIGKILL);
+
+    while (waitpid(_pid, nullptr, 0) < 0 && errno == EINTR) {
+      // Empty
+    }
+
+    _pid = -1;
+  }
+#endif
+}
+
+bool ForkSnapshot::filter(size_t const region,
+                          Snapshot::Size const bits,
+                          Snapshot::Format const format,
+                          Snapshot::Operator const op,
+                          uint32_t const value,
+                          Set* const result,
+                          std::string* const error) {
+
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = kFilter;
+  request.region = region;
+  request.bits = static_cast<uint32_t>(bits);
+  request.format = static_cast<uint32_t>(format);
+  request.op = static_cast<uint32_t>(op);
+  request.value = value;
+
+  Reply reply;
+
+  if (!call(request, &reply, error)) {
+    return false;
+  }
+
+#ifdef __linux__
+  std::vector<uint32_t> addresses;
+
+  for (;;) {
+    uint32_t count;
+
+    if (!receiveAll(_socket, &count, sizeof(count)) || count > kBatchSize) {
+      *error = "Error receiving the filter result";
+      destroy();
+      return false;
+    }
+    else if (count == 0) {
+      break;
+    }
+
+    size_t const size = addresses.size();
+    addresses.resize(size + count);
+
+    if (!receiveAll(_socket, addresses.data() + size, count * sizeof(uint32_t))) {
+      *error = "Error receiving the filter result";
+      destroy();
+      return false;
+    }
+  }
+
+  *result = Set(std::move(addresses));
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ForkSnapshot::read(size_t const region, size_t const offset, void* const data, size_t const size, std::string* const error) {
+  Request request;
+  memset(&request, 0, sizeof(request));
+  request.type = kRead;
+  request.region = region;
+  request.offset = offset;
+  request.size = size;
+
+  Reply reply;
+
+  if (!call(request, &reply, error)) {
+    return false;
+  }
+
+#ifdef __linux__
+  if (!receiveAll(_socket, data, size)) {
+    *error = "Error receiving memory";
+    destroy();
+    return false;
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ForkSnapshot::call(Request const& request, Reply* const reply, std::string* const error) {
+#ifdef __linux__
+  if (_socket < 0) {
+    *error = "The snapshot isn't active";
+    return false;
+  }
+
+  if (!sendAll(_socket, &request, sizeof(request)) || !receiveAll(_socket, reply, sizeof(*reply))) {
+    *error = "The snapshot process has exited";
+    destroy();
+    return false;
+  }
+
+  if (reply->ok == 0) {
+    *error = "Invalid request";
+    return false;
+  }
+
+  return true;
+#else
+  (void)request;
+  (void)reply;
+  *error = "Fork snapshots are only available on Linux";
+  return false;
+#endif
+}
+
+void ForkSnapshot::serve() {
+#ifdef __linux__
+  Request request;
+
+  while (receiveAll(_socket, &request, sizeof(request))) {
+    Reply reply;
+    memset(&reply, 0, sizeof(reply));
+
+    if (request.region >= _regions.size()) {
+      if (!sendAll(_socket, &reply, sizeof(reply))) {
+        return;
+      }
+
+      continue;
+    }
+
+    Region const& region = _regions[request.region];
+    auto const bytes = static_cast<uint8_t const*>(region.data);
+
+    switch (request.type) {
+      case kFilter: {
+        // The frozen image is already private to this process, filter it in
+        // place and stream the matches
+        bool const ok = request.bits <= static_cast<uint32_t>(Snapshot::Size::_32) &&
+                        request.format <= static_cast<uint32_t>(Snapshot::Format::BCDBigEndian) &&
+                        request.op <= static_cast<uint32_t>(Snapshot::Operator::NotEqual);
+
+        reply.ok = ok;
+
+        if (!sendAll(_socket, &reply, sizeof(reply))) {
+          return;
+        }
+
+        if (ok) {
+          SendMatches const send = sendMatches(static_cast<Snapshot::Size>(request.bits),
+                                               static_cast<Snapshot::Format>(request.format),
+                                               static_cast<Snapshot::Operator>(request.op));
+
+          if (!send(_socket, region.address, bytes, region.size, request.value)) {
+            return;
+          }
+        }
+
+        break;
+      }
+
+      case kRead: {
+        bool const ok = request.offset <= region.size && request.size <= region.size - request.offset;
+        reply.ok = ok;
+        reply.size = ok ? request.size : 0;
+
+        if (!sendAll(_socket, &reply, sizeof(reply)) ||
+            (ok && !sendAll(_socket, bytes + request.offset, request.size))) {
+          return;
+        }
+
+        break;
+      }
+
+      default:
+        if (!sendAll(_socket, &reply, sizeof(reply))) {
+          return;
+        }
+
+        break;
+    }
+  }
+#endif
+}
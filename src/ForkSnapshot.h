@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * ForkSnapshot freezes the memory regions by forking the process. The child
+ * gets a copy-on-write image of the whole address space from the kernel, so
+ * taking a snapshot costs the same no matter how big the regions are, and
+ * the pages are only copied when the emulation writes to them. The child
+ * answers queries about the frozen regions over a socket until the snapshot
+ * is destroyed. Only available on Linux.
+ */
+class ForkSnapshot
+{
+public:
+  struct Region
+  {
+    uint32_t    address;
+    void const* data;
+    size_t      size;
+  };
+
+  ForkSnapshot();
+  ~ForkSnapshot();
+
+  static bool supported();
+
+  void addRegion(uint32_t const address, void const* const data, size_t const size);
+  bool create(std::string* const error);
+  void destroy();
+
+  bool active() const { return _pid > 0; }
+  std::vector<Region> const& regions() const { return _regions; }
+
+  // Filters the frozen region in the child process, which streams the
+  // matching addresses back.
+  bool filter(size_t const region,
+              Snapshot::Size const bits,
+              Snapshot::Format const format,
+              Snapshot::Operator const op,
+              uint32_t const value,
+              Set* const result,
+              std::string* const error);
+
+  bool read(size_t const region, size_t const offset, void* const data, size_t const size, std::string* const error);
+
+protected:
+  struct Request
+  {
+    uint32_t type;
+    uint32_t region;
+    uint32_t bits;
+    uint32_t format;
+    uint32_t op;
+    uint32_t value;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  struct Reply
+  {
+    uint32_t ok;
+    uint32_t reserved;
+    uint64_t size;
+  };
+
+  bool call(Request const& request, Reply* const reply, std::string* const error);
+  void serve();
+
+  std::vector<Region> _regions;
+  pid_t               _pid;
+  int                 _socket;
+};
@@ -0,0 +1,197 @@
+#include "FrameDiff.h"
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static unsigned const kBlockSize = 64;
+
+static inline unsigned countTrailingZeros(uint64_t const bits) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(bits);
+#else
+  unsigned count = 0;
+
+  while ((bits >> count & 1) == 0) {
+    count++;
+  }
+
+  return count;
+#endif
+}
+
+// Returns a mask with the bytes that differ in the 64-byte blocks.
+static inline uint64_t compareBlock(uint8_t const* const data, uint8_t const* const shadow) {
+#ifdef __SSE2__
+  __m128i const a0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data +  0)), _mm_loadu_si128(reinterpret_cast<__m128i const*>(shadow +  0)));
+  __m128i const a1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 16)), _mm_loadu_si128(reinterpret_cast<__m128i const*>(shadow + 16)));
+  __m128i const a2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 32)), _mm_loadu_si128(reinterpret_cast<__m128i const*>(shadow + 32)));
+  __m128i const a3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 48)), _mm_loadu_si128(reinterpret_cast<__m128i const*>(shadow + 48)));
+
+  // Most blocks don't change, check the whole block with one movemask
+  if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(a0, a1), _mm_and_si128(a2, a3))) == 0xffff) {
+    return 0;
+  }
+
+  uint64_t const equal = static_cast<uint64_t>(_mm_movemask_epi8(a0)) |
+                         static_cast<uint64_t>(_mm_movemask_epi8(a1)) << 16 |
+                         static_cast<uint64_t>(_mm_movemask_epi8(a2)) << 32 |
+                         static_cast<uint64_t>(_mm_movemask_epi8(a3)) << 48;
+
+  return ~equal;
+#else
+  if (memcmp(data, shadow, kBlockSize) == 0) {
+    return 0;
+  }
+
+  uint64_t bits = 0;
+
+  for (unsigned i = 0; i < kBlockSize; i++) {
+    bits |= static_cast<uint64_t>(data[i] != shadow[i]) << i;
+  }
+
+  return bits;
+#endif
+}
+
+void FrameDiff::addRegion(uint32_t const address, void const* const data, size_t const size) {
+  Region region;
+  region.address = address;
+  region.data = static_cast<uint8_t const*>(data);
+  region.size = size;
+  region.shadow.assign(region.data, region.data + size);
+
+  _regions.emplace_back(std::move(region));
+}
+
+void FrameDiff::reset() {
+  _regions.clear();
+  _changes.clear();
+  _frame = 0;
+  _rescan = true;
+}
+
+bool FrameDiff::setDirtyTracking(bool const enable) {
+  if (enable && !_dirtyPages.active()) {
+    _dirtyPages.init();
+  }
+  else if (!enable) {
+    _dirtyPages.destroy();
+  }
+
+  // Writes before now weren't tracked, the next update must scan everything
+  _rescan = true;
+  return _dirtyPages.active();
+}
+
+void FrameDiff::update() {
+  _changes.clear();
+  _frame++;
+
+  bool const tracking = _dirtyPages.active();
+
+  for (size_t r = 0; r < _regions.size(); r++) {
+    Region& region = _regions[r];
+
+    if (tracking && !_rescan && _dirtyPages.query(region.data, region.size, &region.pages)) {
+      diffPages(r);
+    }
+    else {
+      region.pages.clear();
+      diffRange(r, 0, region.size);
+    }
+  }
+
+  if (tracking) {
+    _rescan = !_dirtyPages.clear();
+  }
+}
+
+void FrameDiff::diffPages(size_t const r) {
+  Region const& region = _regions[r];
+  size_t const pageSize = _dirtyPages.pageSize();
+  uintptr_t const base = reinterpret_cast<uintptr_t>(region.data);
+  uintptr_t const firstPage = base / pageSize * pageSize;
+  size_t next = 0;
+
+  for (size_t w = 0; w < region.pages.size(); w++) {
+    uint64_t bits = region.pages[w];
+
+    while (bits != 0) {
+      size_t const page = w * 64 + countTrailingZeros(bits);
+      bits &= bits - 1;
+
+      // Offsets in the region covered by the page, extended to whole blocks
+      uintptr_t const start = firstPage + page * pageSize;
+      size_t begin = start > base ? start - base : 0;
+      size_t end = std::min(region.size, static_cast<size_t>(start + pageSize - base));
+
+      begin = std::max(begin / kBlockSize * kBlockSize, next);
+      end = std::min(region.size, (end + kBlockSize - 1) / kBlockSize * kBlockSize);
+
+      if (begin < end) {
+        diffRange(r, begin, end);
+        next = end;
+      }
+    }
+  }
+}
+
+void FrameDiff::diffRange(size_t const r, size_t const begin, size_t const end) {
+  Region& region = _regions[r];
+  uint8_t const* const data = region.data;
+  uint8_t* const shadow = region.shadow.data();
+  size_t offset = begin;
+
+  for (; offset + kBlockSize <= end; offset += kBlockSize) {
+    uint64_t const bits = compareBlock(data + offset, shadow + offset);
+
+    if (bits != 0) {
+      emit(r, offset, bits, shadow + offset, data + offset);
+    }
+  }
+
+  if (offset < end) {
+    uint64_t bits = 0;
+
+    for (size_t i = offset; i < end; i++) {
+      bits |= static_cast<uint64_t>(data[i] != shadow[i]) << (i - offset);
+    }
+
+    if (bits != 0) {
+      emit(r, offset, bits, shadow + offset, data + offset);
+    }
+  }
+}
+
+void FrameDiff::emit(size_t const region, size_t const offset, uint64_t bits, uint8_t* const shadow, uint8_t const* const data) {
+  uint32_t const address = _regions[region].address + offset;
+
+  while (bits != 0) {
+    unsigned const start = countTrailingZeros(bits);
+    unsigned length = 0;
+
+    while (length < 8 && start + length < kBlockSize && (bits >> (start + length) & 1) != 0) {
+      length++;
+    }
+
+    Change change;
+    change.frame = _frame;
+    change.address = address + start;
+    change.region = region;
+    change.length = length;
+    memcpy(change.before, shadow + start, length);
+    memcpy(change.after, data + start, length);
+
+    // Update the shadow copy only where the bytes changed, the block can
+    // be shorter than 64 bytes at the end of the region
+    memcpy(shadow + start, data + start, length);
+
+    _changes.emplace_back(change);
+
+    bits &= ~(((UINT64_C(1) << length) - 1) << start);
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "DirtyPages.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * FrameDiff finds what changed in the memory regions since the previous
+ * frame, so that everything interested in changes can share one scan of
+ * memory. Changes are spans of up to 8 consecutive bytes that all changed,
+ * only the first length bytes of before and after are valid.
+ */
+class FrameDiff
+{
+public:
+  struct Change
+  {
+    uint32_t frame;
+    uint32_t address;
+    uint16_t region;
+    uint8_t  length;
+    uint8_t  before[8];
+    uint8_t  after[8];
+  };
+
+  struct Region
+  {
+    uint32_t              address;
+    uint8_t const*        data;
+    size_t                size;
+    std::vector<uint8_t>  shadow;
+    // Pages written in the last frame as reported by DirtyPages, empty
+    // when the whole region was scanned
+    std::vector<uint64_t> pages;
+  };
+
+  FrameDiff() : _frame(0), _rescan(true) {}
+
+  void addRegion(uint32_t const address, void const* const data, size_t const size);
+  void reset();
+
+  // Only scans the pages written since the previous update when the
+  // system supports it, returns false if it doesn't.
+  bool setDirtyTracking(bool const enable);
+  bool dirtyTracking() const { return _dirtyPages.active(); }
+
+  // Diffs the regions against their contents in the previous call, the
+  // first call after adding regions reports no changes.
+  void update();
+
+  std::vector<Region> const& regions() const { return _regions; }
+  std::vector<Change> const& changes() const { return _changes; }
+  uint32_t frame() const { return _frame; }
+
+protected:
+  void diffPages(size_t const r);
+  void diffRange(size_t const r, size_t const begin, size_t const end);
+  void emit(size_t const region, size_t const offset, uint64_t bits, uint8_t* const shadow, uint8_t const* const data);
+
+  std::vector<Region> _regions;
+  std::vector<Change> _changes;
+  uint32_t            _frame;
+  DirtyPages          _dirtyPages;
+  bool                _rescan;
+};
@@ -0,0 +1,95 @@
+#include "Hash.h"
+
+#include <string.h>
+
+static uint64_t const kPrime1 = UINT64_C(0x9E3779B185EBCA87);
+static uint64_t const kPrime2 = UINT64_C(0xC2B2AE3D27D4EB4F);
+static uint64_t const kPrime3 = UINT64_C(0x165667B19E3779F9);
+static uint64_t const kPrime4 = UINT64_C(0x85EBCA77C2B2AE63);
+static uint64_t const kPrime5 = UINT64_C(0x27D4EB2F165667C5);
+
+static inline uint64_t rotl(uint64_t const x, int const r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(uint8_t const* const p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t read32(uint8_t const* const p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t lane(uint64_t acc, uint64_t const input) {
+  acc += input * kPrime2;
+  acc = rotl(acc, 31);
+  return acc * kPrime1;
+}
+
+static inline uint64_t merge(uint64_t acc, uint64_t const value) {
+  acc ^= lane(0, value);
+  return acc * kPrime1 + kPrime4;
+}
+
+uint64_t hash64(void const* const data, size_t const size, uint64_t const seed) {
+  uint8_t const* p = static_cast<uint8_t const*>(data);
+  uint8_t const* const end = p + size;
+  uint64_t h;
+
+  if (size >= 32) {
+    uint8_t const* const limit = end - 32;
+
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+
+    do {
+      v1 = lane(v1, read64(p));
+      v2 = lane(v2, read64(p + 8));
+      v3 = lane(v3, read64(p + 16));
+      v4 = lane(v4, read64(p + 24));
+      p += 32;
+    }
+    while (p <= limit);
+
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge(h, v1);
+    h = merge(h, v2);
+    h = merge(h, v3);
+    h = merge(h, v4);
+  }
+  else {
+    h = seed + kPrime5;
+  }
+
+  h += size;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= lane(0, read64(p));
+    h = rotl(h, 27) * kPrime1 + kPrime4;
+  }
+
+  if (p + 4 <= end) {
+    h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+    h = rotl(h, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+
+  for (; p < end; p++) {
+    h ^= *p * kPrime5;
+    h = rotl(h, 11) * kPrime1;
+  }
+
+  h ^= h >> 33;
+  h *= kPrime2;
+  h ^= h >> 29;
+  h *= kPrime3;
+  h ^= h >> 32;
+
+  return h;
+}
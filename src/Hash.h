@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit hash with the same structure and constants as XXH64, four
+// independent lanes keep the multipliers busy.
+uint64_t hash64(void const* const data, size_t const size, uint64_t const seed);
@@ -0,0 +1,203 @@
+#include "History.h"
+
+#include <algorithm>
+
+ChunkedSet::ChunkedSet(Set const& set) : _size(set.size()), _chunks(0) {
+  auto it = set.begin();
+  auto const end = set.end();
+
+  std::vector<Chunk> chunks;
+
+  while (it != end) {
+    uint32_t const key = *it >> kChunkBits;
+    auto next = it;
+
+    while (next != end && *next >> kChunkBits == key) {
+      ++next;
+    }
+
+    if (!chunks.empty() && chunks.back().key >> kPageBits != key >> kPageBits) {
+      _pages.push_back(Page{chunks.back().key >> kPageBits, std::make_shared<std::vector<Chunk> const>(std::move(chunks))});
+      chunks.clear();
+    }
+
+    chunks.push_back(Chunk{key, std::make_shared<std::vector<uint32_t> const>(it, next)});
+    _chunks++;
+    it = next;
+  }
+
+  if (!chunks.empty()) {
+    _pages.push_back(Page{chunks.back().key >> kPageBits, std::make_shared<std::vector<Chunk> const>(std::move(chunks))});
+  }
+}
+
+ChunkedSet ChunkedSet::without(Set const& removed) const {
+  ChunkedSet result;
+  result._pages.reserve(_pages.size());
+  result._size = _size;
+  result._chunks = _chunks;
+
+  auto it = removed.begin();
+  auto const end = removed.end();
+
+  for (auto const& page : _pages) {
+    while (it != end && *it >> (kChunkBits + kPageBits) < page.key) {
+      ++it;
+    }
+
+    if (it == end || *it >> (kChunkBits + kPageBits) != page.key) {
+      // Nothing removed from this page
+      result._pages.push_back(page);
+      continue;
+    }
+
+    std::vector<Chunk> chunks;
+    chunks.reserve(page.chunks->size());
+
+    for (auto const& chunk : *page.chunks) {
+      while (it != end && *it >> kChunkBits < chunk.key) {
+        ++it;
+      }
+
+      auto next = it;
+
+      while (next != end && *next >> kChunkBits == chunk.key) {
+        ++next;
+      }
+
+      if (next == it) {
+        chunks.push_back(chunk);
+        continue;
+      }
+
+      std::vector<uint32_t> elements;
+      elements.reserve(chunk.elements->size());
+      std::set_difference(chunk.elements->begin(), chunk.elements->end(), it, next, std::back_inserter(elements));
+      it = next;
+
+      result._size -= chunk.elements->size() - elements.size();
+
+      if (elements.empty()) {
+        result._chunks--;
+      }
+      else if (elements.size() == chunk.elements->size()) {
+        // The removed elements weren't in the chunk
+        chunks.push_back(chunk);
+      }
+      else {
+        elements.shrink_to_fit();
+        chunks.push_back(Chunk{chunk.key, std::make_shared<std::vector<uint32_t> const>(std::move(elements))});
+      }
+    }
+
+    if (!chunks.empty()) {
+      result._pages.push_back(Page{page.key, std::make_shared<std::vector<Chunk> const>(std::move(chunks))});
+    }
+  }
+
+  return result;
+}
+
+bool ChunkedSet::contains(uint32_t const element) const {
+  Page const* const page = find(element >> (kChunkBits + kPageBits));
+
+  if (page == nullptr) {
+    return false;
+  }
+
+  uint32_t const key = element >> kChunkBits;
+
+  auto const chunk = std::lower_bound(page->chunks->begin(), page->chunks->end(), key, [](Chunk const& chunk, uint32_t const key) -> bool {
+    return chunk.key < key;
+  });
+
+  return chunk != page->chunks->end() && chunk->key == key &&
+         std::binary_search(chunk->elements->begin(), chunk->elements->end(), element);
+}
+
+Set ChunkedSet::toSet() const {
+  std::vector<uint32_t> elements;
+  elements.reserve(_size);
+
+  for (auto const& page : _pages) {
+    for (auto const& chunk : *page.chunks) {
+      elements.insert(elements.end(), chunk.elements->begin(), chunk.elements->end());
+    }
+  }
+
+  return Set(std::move(elements));
+}
+
+ChunkedSet::Page const* ChunkedSet::find(uint32_t const key) const {
+  auto const it = std::lower_bound(_pages.begin(), _pages.end(), key, [](Page const& page, uint32_t const key) -> bool {
+    return page.key < key;
+  });
+
+  return it != _pages.end() && it->key == key ? &*it : nullptr;
+}
+
+History::Node::Node(size_t const parent, std::string const& label, ChunkedSet&& set, Snapshot const& snapshot)
+  : parent(parent)
+  , lastChild(kNone)
+  , label(label)
+  , set(std::move(set))
+  , snapshot(snapshot) {}
+
+size_t History::push(std::string const& label, Set const& set, Snapshot const& snapshot) {
+  return add(label, ChunkedSet(set), snapshot);
+}
+
+size_t History::pushRemoved(std::string const& label, Set const& removed, Snapshot const& snapshot) {
+  if (_current == kNone) {
+    return kNone;
+  }
+
+  return add(label, _nodes[_current].set.without(removed), snapshot);
+}
+
+size_t History::add(std::string const& label, ChunkedSet&& set, Snapshot const& snapshot) {
+  size_t const index = _nodes.size();
+  _nodes.emplace_back(_current, label, std::move(set), snapshot);
+
+  if (_current != kNone) {
+    _nodes[_current].children.emplace_back(index);
+    _nodes[_current].lastChild = index;
+  }
+
+  _current = index;
+  return index;
+}
+
+bool History::undo() {
+  if (_current == kNone || _nodes[_current].parent == kNone) {
+    return false;
+  }
+
+  size_t const parent = _nodes[_current].parent;
+  _nodes[parent].lastChild = _current;
+  _current = parent;
+  return true;
+}
+
+bool History::redo() {
+  if (_current == kNone || _nodes[_current].lastChild == kNone) {
+    return false;
+  }
+
+  _current = _nodes[_current].lastChild;
+  return true;
+}
+
+bool History::jump(size_t const node) {
+  if (node >= _nodes.size()) {
+    return false;
+  }
+
+  _current = node;
+  return true;
+}
+
+void History::clear() {
+  _nodes.clear();
+  _current = kNone;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * ChunkedSet is an immutable set of addresses, split in chunks of
+ * consecutive addresses, and the chunks are indexed by pages of consecutive
+ * chunks. A set derived from another one shares every chunk and every page
+ * that didn't change, so it only costs the chunks that differ, the pages
+ * that hold them, and one pointer per page.
+ */
+class ChunkedSet
+{
+public:
+  ChunkedSet() : _size(0), _chunks(0) {}
+  explicit ChunkedSet(Set const& set);
+
+  // Returns this set without the elements in removed. Only the chunks with
+  // removed elements are visited, elements that aren't in the set are
+  // ignored.
+  ChunkedSet without(Set const& removed) const;
+
+  size_t size() const { return _size; }
+  size_t chunks() const { return _chunks; }
+  size_t pages() const { return _pages.size(); }
+  bool contains(uint32_t const element) const;
+
+  Set toSet() const;
+
+protected:
+  enum {
+    kChunkBits = 12,
+    kPageBits = 6
+  };
+
+  struct Chunk
+  {
+    uint32_t key;
+    std::shared_ptr<std::vector<uint32_t> const> elements;
+  };
+
+  // The chunks whose keys share the same key >> kPageBits, sorted by key
+  struct Page
+  {
+    uint32_t key;
+    std::shared_ptr<std::vector<Chunk> const> chunks;
+  };
+
+  Page const* find(uint32_t const key) const;
+
+  std::vector<Page> _pages;
+  size_t            _size;
+  size_t            _chunks;
+};
+
+/**
+ * History is a tree of search steps. Each node keeps the candidates after a
+ * filter and the snapshot it was taken against. Undo, redo and jumping to
+ * any node only change the current node, nothing is copied.
+ */
+class History
+{
+public:
+  enum : size_t {
+    kNone = ~static_cast<size_t>(0)
+  };
+
+  struct Node
+  {
+    Node(size_t const parent, std::string const& label, ChunkedSet&& set, Snapshot const& snapshot);
+
+    size_t              parent;
+    size_t              lastChild;
+    std::vector<size_t> children;
+    std::string         label;
+    ChunkedSet          set;
+    Snapshot            snapshot;
+  };
+
+  History() : _current(kNone) {}
+
+  // Adds a node as a child of the current one, and makes it current. The
+  // node shares nothing with its parent, use it for the first step.
+  size_t push(std::string const& label, Set const& set, Snapshot const& snapshot);
+
+  // Adds a node as a child of the current one with its set minus removed,
+  // and makes it current. The node only costs the chunks that lost
+  // elements. Returns kNone if there's no current node.
+  size_t pushRemoved(std::string const& label, Set const& removed, Snapshot const& snapshot);
+
+  bool undo();
+  bool redo();
+  bool jump(size_t const node);
+  void clear();
+
+  size_t current() const { return _current; }
+  size_t count() const { return _nodes.size(); }
+  Node const& node(size_t const index) const { return _nodes[index]; }
+
+protected:
+  size_t add(std::string const& label, ChunkedSet&& set, Snapshot const& snapshot);
+
+  std::vector<Node> _nodes;
+  size_t            _current;
+};
@@ -35,11 +35,14 @@ void Logger::destroy()
 
 void Logger::reset()
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _logger.clear();
 }
 
 void Logger::draw()
 {
+  std::lock_guard<std::mutex> lock(_mutex);
+
   switch (_logger.draw())
   {
   case 1:
@@ -78,6 +81,8 @@ void Logger::draw()
 
 void Logger::vprintf(enum retro_log_level level, const char* fmt, va_list args)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
+
   switch (level)
   {
   case RETRO_LOG_DEBUG: _logger.debug(fmt, args); break;
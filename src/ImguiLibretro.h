@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <unordered_map>
 
 #include <SDL.h>
@@ -32,6 +33,8 @@ public:
 protected:
   static char const* const s_actions[];
 
+  // The emulation thread logs while the UI thread draws the log
+  std::mutex                  _mutex;
   ImGuiAl::BufferedLog<65536> _logger;
 };
 
@@ -1,57 +1,34 @@
 #include "Memory.h"
+#include "Value.h"
 
 #include "imguiext/imguial_fonts.h"
 #include "imguiext/imguidock.h"
 #include "imguiext/imgui_memory_editor.h"
 
+#include <algorithm>
 #include <stdint.h>
 
 bool Memory::init(libretro::CoreManager* core)
 {
   _core = core;
   _selected = 0;
+  _built = false;
+  _mapVersion = 0;
+  _generation = 0;
   return true;
 }
 
 void Memory::destroy()
 {
-  _map.clear();
+  reset();
 }
 
 void Memory::draw(bool running)
 {
+  (void)running;
+
   if (ImGui::Begin(ICON_FA_MICROCHIP " Memory"))
   {
-    if (running && _map.size() == 0)
-    {
-      addMemory(RETRO_MEMORY_SYSTEM_RAM, "System RAM ");
-      addMemory(RETRO_MEMORY_SAVE_RAM,   "Save RAM   ");
-      addMemory(RETRO_MEMORY_VIDEO_RAM,  "Video RAM  ");
-      addMemory(RETRO_MEMORY_RTC,        "RTC RAM    ");
-
-      std::vector<libretro::MemoryDescriptor> const& map = _core->getMemoryMap();
-
-      for (auto const& desc : map)
-      {
-        if (desc.ptr == nullptr || desc.len == 0)
-        {
-          continue;
-        }
-
-        char name[64];
-        int numWritten = snprintf(name, sizeof(name), "@%08X  ", (unsigned)desc.start);
-        asMemorySize(name + numWritten, sizeof(name) - numWritten, desc.len);
-        
-        Region region;
-        region.address = static_cast<uint32_t>(desc.start);
-        region.data = static_cast<void*>(static_cast<uint8_t*>(desc.ptr) + desc.offset);
-        region.size = desc.len;
-        region.name = name;
-
-        _map.emplace_back(std::move(region));
-      }
-    }
-
     struct Getter
     {
       static bool description(void* data, int idx, const char** out_text)
@@ -77,10 +54,79 @@ void Memory::draw(bool running)
   ImGui::End();
 }
 
+void Memory::update()
+{
+  bool changed = !_built || _mapVersion != _core->getMemoryMapVersion();
+
+  for (unsigned id = 0; id < kSources && !changed; id++)
+  {
+    changed = _sources[id] != _core->getMemoryData(id) || _sourceSizes[id] != _core->getMemorySize(id);
+  }
+
+  if (changed)
+  {
+    rebuild();
+  }
+}
+
+void Memory::rebuild()
+{
+  _map.clear();
+  _built = true;
+  _mapVersion = _core->getMemoryMapVersion();
+
+  for (unsigned id = 0; id < kSources; id++)
+  {
+    _sources[id] = _core->getMemoryData(id);
+    _sourceSizes[id] = _core->getMemorySize(id);
+  }
+
+  addMemory(RETRO_MEMORY_SYSTEM_RAM, "System RAM ");
+  addMemory(RETRO_MEMORY_SAVE_RAM,   "Save RAM   ");
+  addMemory(RETRO_MEMORY_VIDEO_RAM,  "Video RAM  ");
+  addMemory(RETRO_MEMORY_RTC,        "RTC RAM    ");
+
+  std::vector<libretro::MemoryDescriptor> const& map = _core->getMemoryMap();
+  size_t const firstDescriptor = _map.size();
+
+  for (auto const& desc : map)
+  {
+    if (desc.ptr == nullptr || desc.len == 0)
+    {
+      continue;
+    }
+
+    char name[64];
+    int numWritten = snprintf(name, sizeof(name), "@%08X  ", (unsigned)desc.start);
+    asMemorySize(name + numWritten, sizeof(name) - numWritten, desc.len);
+    
+    Region region;
+    region.address = static_cast<uint32_t>(desc.start);
+    region.data = static_cast<void*>(static_cast<uint8_t*>(desc.ptr) + desc.offset);
+    region.size = desc.len;
+    region.name = name;
+
+    _map.emplace_back(std::move(region));
+  }
+
+  canonicalize(firstDescriptor);
+
+  _generation++;
+
+  if (static_cast<size_t>(_selected) >= _map.size())
+  {
+    _selected = 0;
+  }
+}
+
 void Memory::reset()
 {
   _map.clear();
+  _canonical.clear();
+  _aliases.clear();
   _selected = 0;
+  _built = false;
+  _generation++;
 }
 
 Snapshot Memory::click() const {
@@ -95,6 +141,165 @@ Snapshot Memory::click() const {
   }
 }
 
+std::vector<Snapshot> Memory::clickAll() const
+{
+  std::vector<Snapshot> snapshots;
+  snapshots.reserve(_canonical.size());
+
+  for (auto const& region : _canonical)
+  {
+    snapshots.emplace_back(region.address, region.data, region.size);
+  }
+
+  return snapshots;
+}
+
+uint32_t Memory::canonical(uint32_t const address) const
+{
+  for (auto const& alias : _aliases)
+  {
+    if (address >= alias.address && address - alias.address < alias.size)
+    {
+      return alias.canonical + (address - alias.address);
+    }
+  }
+
+  return address;
+}
+
+bool Memory::peek(uint32_t const address, Snapshot::Size const bits, Snapshot::Format const format, uint32_t* const value) const
+{
+  if (!_core->getMemoryMap().empty())
+  {
+    // Emulated addresses come from the memory map, which the core manager
+    // translates without searching the regions
+    uint8_t bytes[4];
+
+    if (!_core->read(address, bytes, sizeOf(bits)))
+    {
+      return false;
+    }
+
+    *value = read(bits, format, bytes);
+    return true;
+  }
+
+  uint32_t const canon = canonical(address);
+  size_t const size = sizeOf(bits);
+
+  for (auto const& region : _canonical)
+  {
+    if (canon >= region.address && canon - region.address + size <= region.size)
+    {
+      *value = read(bits, format, static_cast<uint8_t const*>(region.data) + (canon - region.address));
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void Memory::canonicalize(size_t const firstDescriptor)
+{
+  // Descriptors are preferred over the RETRO_MEMORY_* regions because they
+  // have the emulated addresses, and bigger descriptors over smaller ones
+  // because mirrors are usually windows into a bigger buffer
+  std::vector<size_t> order;
+
+  for (size_t i = 0; i < _map.size(); i++)
+  {
+    order.emplace_back(i);
+  }
+
+  std::stable_sort(order.begin(), order.end(), [&](size_t const a, size_t const b) -> bool {
+    bool const da = a >= firstDescriptor, db = b >= firstDescriptor;
+
+    if (da != db)
+    {
+      return da;
+    }
+    else if (_map[a].size != _map[b].size)
+    {
+      return _map[a].size > _map[b].size;
+    }
+
+    return _map[a].address < _map[b].address;
+  });
+
+  struct Claim
+  {
+    uintptr_t begin;
+    uintptr_t end;
+    uint32_t  address;
+  };
+
+  std::vector<Claim> claims;
+
+  _canonical.clear();
+  _aliases.clear();
+
+  for (size_t const index : order)
+  {
+    Region const& region = _map[index];
+    uintptr_t const begin = reinterpret_cast<uintptr_t>(region.data);
+    uintptr_t const end = begin + region.size;
+    uintptr_t cursor = begin;
+
+    // Claims are sorted and don't overlap, so the parts of the region that
+    // are not claimed yet are the gaps between the claims it overlaps
+    std::vector<Claim> pieces;
+
+    for (auto const& claim : claims)
+    {
+      if (claim.end <= cursor || claim.begin >= end)
+      {
+        continue;
+      }
+
+      if (claim.begin > cursor)
+      {
+        pieces.push_back({cursor, claim.begin, static_cast<uint32_t>(region.address + (cursor - begin))});
+      }
+
+      uintptr_t const aliasBegin = std::max(cursor, claim.begin);
+      uintptr_t const aliasEnd = std::min(end, claim.end);
+
+      Alias alias;
+      alias.address = region.address + (aliasBegin - begin);
+      alias.size = aliasEnd - aliasBegin;
+      alias.canonical = claim.address + (aliasBegin - claim.begin);
+      _aliases.emplace_back(alias);
+
+      cursor = aliasEnd;
+    }
+
+    if (cursor < end)
+    {
+      pieces.push_back({cursor, end, static_cast<uint32_t>(region.address + (cursor - begin))});
+    }
+
+    for (auto const& piece : pieces)
+    {
+      Region canonical;
+      canonical.name = region.name;
+      canonical.address = piece.address;
+      canonical.data = reinterpret_cast<void*>(piece.begin);
+      canonical.size = piece.end - piece.begin;
+
+      _canonical.emplace_back(std::move(canonical));
+      claims.emplace_back(piece);
+    }
+
+    std::sort(claims.begin(), claims.end(), [](Claim const& a, Claim const& b) -> bool {
+      return a.begin < b.begin;
+    });
+  }
+
+  std::stable_sort(_canonical.begin(), _canonical.end(), [](Region const& a, Region const& b) -> bool {
+    return a.address < b.address;
+  });
+}
+
 void Memory::asMemorySize(char* str, size_t size, size_t numBytes)
 {
   static char const* const units[] = {"bytes", "KiB", "MiB", "GiB", nullptr};
@@ -13,30 +13,72 @@
 class Memory
 {
 public:
+  struct Region
+  {
+    std::string name;
+    uint32_t address;
+    void* data;
+    size_t size;
+  };
+
   bool init(libretro::CoreManager* core);
   void destroy();
   void draw(bool running);
 
   void reset();
 
+  // Rebuilds the regions when the core has changed its memory, must be
+  // called after each frame.
+  void update();
+
+  // Changes every time the regions are rebuilt.
+  unsigned generation() const { return _generation; }
+
   Snapshot click() const;
+  std::vector<Snapshot> clickAll() const;
+
+  // Regions with each host byte only once, see canonicalize.
+  std::vector<Region> const& regions() const { return _canonical; }
+
+  // Maps an address in a mirror to the address where its bytes are found
+  // in regions().
+  uint32_t canonical(uint32_t const address) const;
+
+  // Reads the value at address, mirrors included. Returns false if the value
+  // isn't entirely mapped.
+  bool peek(uint32_t const address, Snapshot::Size const bits, Snapshot::Format const format, uint32_t* const value) const;
 
 protected:
-  struct Region
+  struct Alias
   {
-    std::string name;
     uint32_t address;
-    void* data;
-    size_t size;
+    size_t   size;
+    uint32_t canonical;
   };
 
   static void asMemorySize(char* str, size_t size, size_t numBytes);
   void addMemory(unsigned id, char const* name);
+  void canonicalize(size_t const firstDescriptor);
+  void rebuild();
 
   void drawMemory(bool running);
   void drawFilters();
 
   libretro::CoreManager* _core;
   std::vector<Region> _map;
+  std::vector<Region> _canonical;
+  std::vector<Alias> _aliases;
   int _selected;
+
+  enum
+  {
+    // RETRO_MEMORY_SAVE_RAM to RETRO_MEMORY_VIDEO_RAM
+    kSources = 4
+  };
+
+  bool _built;
+  unsigned _mapVersion;
+  void* _sources[kSources];
+  size_t _sourceSizes[kSources];
+  unsigned _generation;
 };
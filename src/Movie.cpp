@@ -0,0 +1,1428 @@
+#include "Movie.h"
+#include "Hash.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <string.h>
+
+// Everything in the file is little endian. Chunks are a four character tag
+// and the size of what follows as a uint32_t:
+//
+//   INFO  hashes of the core and content files, the frame the movie starts
+//         at, and the name and version of the core
+//   STAT  the state to start from, missing when starting from power-on
+//   HREG  the size of the hashed blocks, the number of hashed regions, then
+//         for each one a byte set to 1 for the state, its name and its size;
+//         missing when there are no hashes
+//   FRMS  the first frame and the number of frames, then a record for each
+//         frame: a varint with 0 for the same values as the previous frame
+//         or the number of values plus one, followed by the zigzag varint of
+//         each value; the first record of a chunk is never 0
+//   HASH  right after each FRMS when there are hashes, the same first frame
+//         and number of frames, then for each frame and region the varint
+//         number of blocks, the varint number of blocks that changed since
+//         the previous frame, and for each of those the varint distance from
+//         the previous one and the hash; in the first frame of a chunk all
+//         the blocks are there
+//   INDX  the number of FRMS chunks, then their first frame, number of
+//         frames and offset in the file
+//   IEND  the offset of INDX, always the last 16 bytes of the file
+
+static void put32(std::vector<uint8_t>* const out, uint32_t const value)
+{
+  for (unsigned i = 0; i < 32; i += 8)
+  {
+    out->push_back(static_cast<uint8_t>(value >> i));
+  }
+}
+
+static void put64(std::vector<uint8_t>* const out, uint64_t const value)
+{
+  put32(out, static_cast<uint32_t>(value));
+  put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+static void putVarint(std::vector<uint8_t>* const out, uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+static void putString(std::vector<uint8_t>* const out, std::string const& string)
+{
+  put32(out, static_cast<uint32_t>(string.length()));
+  out->insert(out->end(), string.begin(), string.end());
+}
+
+static uint32_t get32(uint8_t const* const data)
+{
+  return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+static uint64_t get64(uint8_t const* const data)
+{
+  return get32(data) | static_cast<uint64_t>(get32(data + 4)) << 32;
+}
+
+static bool getString(std::vector<uint8_t> const& in, size_t* const position, std::string* const string)
+{
+  if (in.size() - *position < 4 || in.size() - *position - 4 < get32(&in[*position]))
+  {
+    return false;
+  }
+
+  size_t const length = get32(&in[*position]);
+  string->assign(in.begin() + *position + 4, in.begin() + *position + 4 + length);
+  *position += 4 + length;
+  return true;
+}
+
+static bool getVarint(std::vector<uint8_t> const& in, size_t* const position, uint32_t* const value)
+{
+  *value = 0;
+
+  for (unsigned shift = 0; shift < 35 && *position < in.size(); shift += 7)
+  {
+    uint8_t const byte = in[(*position)++];
+    *value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+
+    if ((byte & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static uint32_t zigzag(int16_t const value)
+{
+  return static_cast<uint16_t>((static_cast<uint16_t>(value) << 1) ^ (value >> 15));
+}
+
+static int16_t unzigzag(uint32_t const value)
+{
+  return static_cast<int16_t>((value >> 1) ^ (0 - (value & 1)));
+}
+
+static bool hashFile(std::string const& path, uint64_t* const hash, std::string* const error)
+{
+  *hash = 0;
+
+  if (path.empty())
+  {
+    // Cores that run without content
+    return true;
+  }
+
+  FILE* file = fopen(path.c_str(), "rb");
+
+  if (file == NULL)
+  {
+    *error = "Error opening " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  // A MiB at a time, the hash of each block is the seed of the next one
+  std::vector<uint8_t> buffer(1 << 20);
+  size_t count;
+
+  while ((count = fread(buffer.data(), 1, buffer.size(), file)) != 0)
+  {
+    *hash = hash64(buffer.data(), count, *hash);
+  }
+
+  bool const ok = !ferror(file);
+  fclose(file);
+
+  if (!ok)
+  {
+    *error = "Error reading " + path;
+  }
+
+  return ok;
+}
+
+bool Movie::init(libretro::CoreManager* core, Memory* memory, libretro::InputComponent* input, libretro::LoggerComponent* logger)
+{
+  _core = core;
+  _memory = memory;
+  _input = input;
+  _logger = logger;
+
+  _mode = Mode::Idle;
+  _file = NULL;
+  _size = 0;
+  _first = 0;
+  _frames = 0;
+  _desyncs = 0;
+  _firstDesync = 0;
+  _hashed = false;
+  _verify = false;
+  _generation = 0;
+  _hashSum = 0.0;
+  _hashCount = 0;
+  _hashAverage = 0.0;
+
+  strcpy(_path, "movie.chmv");
+  _uiMemory = false;
+  _uiState = false;
+  _uiGeneration = 0;
+  return true;
+}
+
+void Movie::destroy()
+{
+  std::string error;
+  stop(&error);
+}
+
+void Movie::reset()
+{
+  std::string error;
+  stop(&error);
+
+  _corePath.clear();
+  _contentPath.clear();
+  _status.clear();
+}
+
+void Movie::setContent(std::string const& corePath, std::string const& contentPath)
+{
+  _corePath = corePath;
+  _contentPath = contentPath;
+}
+
+bool Movie::record(char const* const path, std::vector<size_t> const& regions, bool const state, std::string* const error)
+{
+  if (active() && !stop(error))
+  {
+    return false;
+  }
+
+  uint64_t coreHash, contentHash;
+
+  if (!hashFile(_corePath, &coreHash, error) || !hashFile(_contentPath, &contentHash, error))
+  {
+    return false;
+  }
+
+  uint64_t const first = _core->getFrameCount();
+  std::vector<uint8_t> start;
+
+  if (first != 0)
+  {
+    start.resize(_core->serializeSize());
+
+    if (start.empty() || !_core->serialize(start.data(), start.size()))
+    {
+      *error = "The core doesn't support savestates, record right after loading the game";
+      return false;
+    }
+  }
+
+  std::vector<Memory::Region> const& available = _memory->regions();
+  _checked.clear();
+
+  for (auto const index : regions)
+  {
+    if (index >= available.size())
+    {
+      *error = "Invalid memory region";
+      return false;
+    }
+
+    _checked.push_back({available[index].name, false, index, available[index].size, {}, {}});
+  }
+
+  if (state)
+  {
+    if (_core->serializeSize() == 0)
+    {
+      *error = "The core doesn't support savestates, its state can't be checked";
+      return false;
+    }
+
+    _checked.push_back({"state", true, 0, _core->serializeSize(), {}, {}});
+  }
+
+  std::vector<uint8_t> checked;
+
+  if (!_checked.empty())
+  {
+    put32(&checked, kHashBlock);
+    put32(&checked, static_cast<uint32_t>(_checked.size()));
+
+    for (auto const& check : _checked)
+    {
+      checked.push_back(check.state ? 1 : 0);
+      putString(&checked, check.name);
+      put64(&checked, check.size);
+    }
+  }
+
+  _file = fopen(path, "wb");
+
+  if (_file == NULL)
+  {
+    *error = std::string("Error creating ") + path + ": " + strerror(errno);
+    return false;
+  }
+
+  std::vector<uint8_t> header;
+  header.insert(header.end(), {'C', 'H', 'M', 'V'});
+  put32(&header, kVersion);
+
+  std::vector<uint8_t> info;
+  put64(&info, coreHash);
+  put64(&info, contentHash);
+  put64(&info, first);
+  putString(&info, _core->getSystemInfo().libraryName);
+  putString(&info, _core->getSystemInfo().libraryVersion);
+
+  _offset = 0;
+
+  if (fwrite(header.data(), 1, header.size(), _file) != header.size())
+  {
+    *error = std::string("Error writing the movie: ") + strerror(errno);
+    close();
+    return false;
+  }
+
+  _offset = header.size();
+
+  if (!writeChunk("INFO", info.data(), info.size(), error) ||
+      (first != 0 && !writeChunk("STAT", start.data(), start.size(), error)) ||
+      (!_checked.empty() && !writeChunk("HREG", checked.data(), checked.size(), error)))
+  {
+    close();
+    return false;
+  }
+
+  _mode = Mode::Recording;
+  _first = first;
+  _frames = 0;
+  _chunks.clear();
+  _values.clear();
+  _previous.clear();
+  _records.clear();
+  _count = 0;
+  _desyncs = 0;
+  _hashed = !_checked.empty();
+  _verify = false;
+  _generation = _memory->generation();
+  _hashes.clear();
+  _divergence.clear();
+  _hashSum = 0.0;
+  _hashCount = 0;
+  _hashAverage = 0.0;
+  return true;
+}
+
+bool Movie::play(char const* const path, std::string* const error)
+{
+  if (active() && !stop(error))
+  {
+    return false;
+  }
+
+  _file = fopen(path, "rb");
+
+  if (_file == NULL)
+  {
+    *error = std::string("Error opening ") + path + ": " + strerror(errno);
+    return false;
+  }
+
+  long const size = fseek(_file, 0, SEEK_END) == 0 ? ftell(_file) : -1;
+
+  if (size < 0 || fseek(_file, 0, SEEK_SET) != 0)
+  {
+    *error = std::string("Error reading ") + path + ": " + strerror(errno);
+    close();
+    return false;
+  }
+
+  _size = static_cast<uint64_t>(size);
+  uint8_t header[8];
+  char tag[4];
+  std::vector<uint8_t> info, state, checked, payload;
+
+  if (fread(header, 1, sizeof(header), _file) != sizeof(header) || memcmp(header, "CHMV", 4) != 0)
+  {
+    *error = std::string(path) + " isn't a movie";
+    close();
+    return false;
+  }
+  else if (get32(header + 4) != kVersion)
+  {
+    *error = "Unsupported movie version";
+    close();
+    return false;
+  }
+
+  _offset = sizeof(header);
+
+  if (!readChunk(tag, &info, error))
+  {
+    close();
+    return false;
+  }
+  else if (memcmp(tag, "INFO", 4) != 0 || info.size() < 32)
+  {
+    *error = "Invalid movie header";
+    close();
+    return false;
+  }
+
+  uint64_t const coreHash = get64(info.data());
+  uint64_t const contentHash = get64(info.data() + 8);
+  uint64_t const first = get64(info.data() + 16);
+
+  // The frames start after the optional chunks
+  uint64_t start;
+
+  for (;;)
+  {
+    start = _offset;
+
+    if (!readChunk(tag, &payload, error))
+    {
+      close();
+      return false;
+    }
+    else if (memcmp(tag, "STAT", 4) == 0)
+    {
+      state.swap(payload);
+    }
+    else if (memcmp(tag, "HREG", 4) == 0)
+    {
+      checked.swap(payload);
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  uint64_t currentCore, currentContent;
+
+  if (!hashFile(_corePath, &currentCore, error) || !hashFile(_contentPath, &currentContent, error))
+  {
+    close();
+    return false;
+  }
+  else if (currentContent != contentHash)
+  {
+    *error = "The movie was recorded with different content";
+    close();
+    return false;
+  }
+  else if (currentCore != coreHash)
+  {
+    // Often still in sync, but not guaranteed
+    _logger->printf(RETRO_LOG_WARN, "The movie was recorded with a different build of the core");
+  }
+
+  _checked.clear();
+  _hashed = !checked.empty();
+  _verify = _hashed;
+
+  if (_hashed)
+  {
+    size_t position = 8;
+
+    if (checked.size() < 8 || get32(checked.data()) != kHashBlock)
+    {
+      *error = "Invalid or unsupported movie hashes";
+      close();
+      return false;
+    }
+
+    std::vector<Memory::Region> const& available = _memory->regions();
+    uint32_t const count = get32(checked.data() + 4);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      Checked check;
+
+      if (position >= checked.size())
+      {
+        *error = "Invalid or unsupported movie hashes";
+        close();
+        return false;
+      }
+
+      check.state = checked[position++] != 0;
+      check.region = 0;
+
+      if (!getString(checked, &position, &check.name) || checked.size() - position < 8)
+      {
+        *error = "Invalid or unsupported movie hashes";
+        close();
+        return false;
+      }
+
+      check.size = get64(&checked[position]);
+      position += 8;
+
+      if (!check.state)
+      {
+        auto const found = std::find_if(available.begin(), available.end(), [&check](Memory::Region const& region) {
+          return region.name == check.name && region.size == check.size;
+        });
+
+        if (found == available.end())
+        {
+          // The replay still works, but can't be checked
+          _logger->printf(RETRO_LOG_WARN, "The memory region %s isn't the same, the movie won't be checked", check.name.c_str());
+          _verify = false;
+        }
+        else
+        {
+          check.region = found - available.begin();
+        }
+      }
+
+      _checked.emplace_back(check);
+    }
+
+    _generation = _memory->generation();
+  }
+
+  if (!state.empty())
+  {
+    if (!_core->unserialize(state.data(), state.size(), first))
+    {
+      *error = "Error loading the start state of the movie";
+      close();
+      return false;
+    }
+  }
+  else if (first != 0 || _core->getFrameCount() != 0)
+  {
+    *error = "The movie starts at power-on, load the game again to play it";
+    close();
+    return false;
+  }
+
+  if (!readIndex(start, error))
+  {
+    close();
+    return false;
+  }
+
+  if (_chunks.empty())
+  {
+    *error = "The movie has no frames";
+    close();
+    return false;
+  }
+
+  _mode = Mode::Playing;
+  _first = first;
+  _frames = _chunks.back().first + _chunks.back().count - 1 - first;
+  _desyncs = 0;
+  _divergence.clear();
+  _hashSum = 0.0;
+  _hashCount = 0;
+  _hashAverage = 0.0;
+
+  if (!seek(first, error))
+  {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+bool Movie::seek(uint64_t const frame, std::string* const error)
+{
+  if (_mode != Mode::Playing)
+  {
+    *error = "No movie is playing";
+    return false;
+  }
+
+  // Find the chunk with the frame after this one
+  uint64_t const next = frame + 1;
+
+  auto const found = std::upper_bound(_chunks.begin(), _chunks.end(), next, [](uint64_t const value, Chunk const& chunk) {
+    return value < chunk.first;
+  });
+
+  if (found == _chunks.begin() || next >= (found - 1)->first + (found - 1)->count)
+  {
+    char message[128];
+    snprintf(message, sizeof(message), "Frame %llu isn't in the movie", static_cast<unsigned long long>(next));
+    *error = message;
+    return false;
+  }
+
+  size_t const index = found - 1 - _chunks.begin();
+
+  if (!loadFrames(index, error))
+  {
+    return false;
+  }
+
+  for (uint64_t i = _chunks[index].first; i <= next; i++)
+  {
+    if (!decodeFrame(error))
+    {
+      return false;
+    }
+  }
+
+  // The hashes of the next frame are checked after it runs
+  for (uint64_t i = _chunks[index].first; _verify && i < next; i++)
+  {
+    if (!decodeHashes(i, error))
+    {
+      return false;
+    }
+  }
+
+  _next = next;
+  return true;
+}
+
+bool Movie::stop(std::string* const error)
+{
+  bool ok = true;
+
+  if (_mode == Mode::Recording)
+  {
+    ok = flushFrames(error);
+
+    if (ok)
+    {
+      std::vector<uint8_t> index, end;
+      put32(&index, static_cast<uint32_t>(_chunks.size()));
+
+      for (auto const& chunk : _chunks)
+      {
+        put64(&index, chunk.first);
+        put32(&index, chunk.count);
+        put64(&index, chunk.offset);
+      }
+
+      put64(&end, _offset);
+      ok = writeChunk("INDX", index.data(), index.size(), error) && writeChunk("IEND", end.data(), end.size(), error);
+    }
+
+    if (fclose(_file) != 0 && ok)
+    {
+      *error = std::string("Error writing the movie: ") + strerror(errno);
+      ok = false;
+    }
+
+    _file = NULL;
+  }
+
+  if (_desyncs != 0)
+  {
+    char message[128];
+    snprintf(message, sizeof(message), "%llu frames read a different number of inputs than recorded, the first one is %llu", static_cast<unsigned long long>(_desyncs), static_cast<unsigned long long>(_firstDesync));
+    _status = message;
+  }
+
+  if (!_divergence.empty())
+  {
+    _status = _status.empty() ? _divergence : _divergence + "\n" + _status;
+  }
+
+  close();
+  return ok;
+}
+
+bool Movie::writeChunk(char const* const tag, void const* const data, size_t const size, std::string* const error)
+{
+  std::vector<uint8_t> header(tag, tag + 4);
+  put32(&header, static_cast<uint32_t>(size));
+
+  if (fwrite(header.data(), 1, header.size(), _file) != header.size() || fwrite(data, 1, size, _file) != size || fflush(_file) != 0)
+  {
+    *error = std::string("Error writing the movie: ") + strerror(errno);
+    return false;
+  }
+
+  _offset += header.size() + size;
+  return true;
+}
+
+bool Movie::flushFrames(std::string* const error)
+{
+  if (_count == 0)
+  {
+    return true;
+  }
+
+  Chunk const chunk = {_first + _frames - _count + 1, _count, _offset};
+
+  std::vector<uint8_t> payload;
+  payload.reserve(12 + _records.size());
+  put64(&payload, chunk.first);
+  put32(&payload, chunk.count);
+  payload.insert(payload.end(), _records.begin(), _records.end());
+
+  if (!writeChunk("FRMS", payload.data(), payload.size(), error))
+  {
+    return false;
+  }
+
+  if (_hashed)
+  {
+    payload.resize(12);
+    payload.insert(payload.end(), _hashes.begin(), _hashes.end());
+
+    if (!writeChunk("HASH", payload.data(), payload.size(), error))
+    {
+      return false;
+    }
+  }
+
+  _chunks.emplace_back(chunk);
+  _records.clear();
+  _hashes.clear();
+  _count = 0;
+  return true;
+}
+
+void Movie::encodeFrame()
+{
+  if (_count != 0 && _values == _previous)
+  {
+    _records.push_back(0);
+  }
+  else
+  {
+    putVarint(&_records, static_cast<uint32_t>(_values.size() + 1));
+
+    for (auto const value : _values)
+    {
+      putVarint(&_records, zigzag(value));
+    }
+  }
+
+  _previous.swap(_values);
+  _values.clear();
+  _count++;
+  _frames++;
+}
+
+bool Movie::readChunk(char* const tag, std::vector<uint8_t>* const payload, std::string* const error)
+{
+  uint8_t header[8];
+
+  if (fread(header, 1, sizeof(header), _file) != sizeof(header))
+  {
+    *error = "The movie is truncated";
+    return false;
+  }
+
+  memcpy(tag, header, 4);
+
+  // Don't allocate what a corrupted size says
+  long const position = ftell(_file);
+
+  if (position < 0 || static_cast<uint64_t>(position) > _size || get32(header + 4) > _size - static_cast<uint64_t>(position))
+  {
+    *error = "The movie is truncated";
+    return false;
+  }
+
+  payload->resize(get32(header + 4));
+
+  if (fread(payload->data(), 1, payload->size(), _file) != payload->size())
+  {
+    *error = "The movie is truncated";
+    return false;
+  }
+
+  _offset += sizeof(header) + payload->size();
+  return true;
+}
+
+bool Movie::readIndex(uint64_t const start, std::string* const error)
+{
+  _chunks.clear();
+
+  uint8_t trailer[16];
+
+  if (fseek(_file, -static_cast<long>(sizeof(trailer)), SEEK_END) == 0 &&
+      fread(trailer, 1, sizeof(trailer), _file) == sizeof(trailer) &&
+      memcmp(trailer, "IEND", 4) == 0 && get32(trailer + 4) == 8 &&
+      fseek(_file, static_cast<long>(get64(trailer + 8)), SEEK_SET) == 0)
+  {
+    char tag[4];
+    std::vector<uint8_t> index;
+
+    if (readChunk(tag, &index, error) && memcmp(tag, "INDX", 4) == 0 && index.size() >= 4 && index.size() == 4 + get32(index.data()) * size_t(20))
+    {
+      for (size_t i = 4; i < index.size(); i += 20)
+      {
+        _chunks.push_back({get64(&index[i]), get32(&index[i + 8]), get64(&index[i + 12])});
+      }
+
+      return true;
+    }
+  }
+
+  // No index, the recording didn't stop properly; walk the chunks up to
+  // the last complete one
+  if (fseek(_file, 0, SEEK_END) != 0)
+  {
+    *error = std::string("Error reading the movie: ") + strerror(errno);
+    return false;
+  }
+
+  uint64_t const end = ftell(_file);
+  uint64_t offset = start;
+  // With hashes, frames only count once their hashes are complete too
+  Chunk pending;
+  bool hasPending = false;
+
+  while (offset + 8 <= end && fseek(_file, static_cast<long>(offset), SEEK_SET) == 0)
+  {
+    uint8_t header[20];
+
+    if (fread(header, 1, 8, _file) != 8)
+    {
+      break;
+    }
+
+    uint64_t const next = offset + 8 + get32(header + 4);
+
+    if (next > end)
+    {
+      break;
+    }
+    else if (memcmp(header, "FRMS", 4) == 0)
+    {
+      if (get32(header + 4) < 12 || fread(header + 8, 1, 12, _file) != 12)
+      {
+        break;
+      }
+
+      pending = {get64(header + 8), get32(header + 16), offset};
+      hasPending = true;
+    }
+
+    if (hasPending && (!_hashed || memcmp(header, "HASH", 4) == 0))
+    {
+      _chunks.push_back(pending);
+      hasPending = false;
+    }
+
+    offset = next;
+  }
+
+  _logger->printf(RETRO_LOG_WARN, "The movie has no index, it was rebuilt with %zu chunks", _chunks.size());
+  return true;
+}
+
+bool Movie::loadFrames(size_t const chunk, std::string* const error)
+{
+  char tag[4];
+
+  if (chunk >= _chunks.size())
+  {
+    *error = "Read past the end of the movie";
+    return false;
+  }
+  else if (fseek(_file, static_cast<long>(_chunks[chunk].offset), SEEK_SET) != 0)
+  {
+    *error = std::string("Error reading the movie: ") + strerror(errno);
+    return false;
+  }
+  else if (!readChunk(tag, &_records, error))
+  {
+    return false;
+  }
+  else if (memcmp(tag, "FRMS", 4) != 0 || _records.size() < 12 || get64(_records.data()) != _chunks[chunk].first || get32(_records.data() + 8) != _chunks[chunk].count)
+  {
+    *error = "The movie index doesn't match its chunks";
+    return false;
+  }
+
+  if (_hashed)
+  {
+    if (!readChunk(tag, &_hashes, error))
+    {
+      return false;
+    }
+    else if (memcmp(tag, "HASH", 4) != 0 || _hashes.size() < 12 || memcmp(_hashes.data(), _records.data(), 12) != 0)
+    {
+      *error = "The movie hashes don't match their frames";
+      return false;
+    }
+  }
+
+  _chunk = chunk;
+  _position = 12;
+  _hashPosition = 12;
+  _left = _chunks[chunk].count;
+  return true;
+}
+
+bool Movie::decodeFrame(std::string* const error)
+{
+  if (_left == 0 && !loadFrames(_chunk + 1, error))
+  {
+    return false;
+  }
+
+  uint32_t header;
+
+  // Each value takes at least a byte, don't allocate more than the chunk has
+  if (!getVarint(_records, &_position, &header) || (header == 0 && _left == _chunks[_chunk].count) ||
+      (header != 0 && header - 1 > _records.size() - _position))
+  {
+    *error = "The movie is corrupted";
+    return false;
+  }
+
+  // With 0 the values are the same as in the previous frame
+  if (header != 0)
+  {
+    _values.resize(header - 1);
+
+    for (auto& value : _values)
+    {
+      uint32_t encoded;
+
+      if (!getVarint(_records, &_position, &encoded))
+      {
+        *error = "The movie is corrupted";
+        return false;
+      }
+
+      value = unzigzag(encoded);
+    }
+  }
+
+  _left--;
+  _cursor = 0;
+  return true;
+}
+
+bool Movie::resolveRegions(std::string* const error)
+{
+  if (_generation == _memory->generation())
+  {
+    return true;
+  }
+
+  // The core changed its memory map, the indices may be out of range or
+  // point to other regions
+  std::vector<Memory::Region> const& available = _memory->regions();
+
+  for (auto& check : _checked)
+  {
+    if (check.state)
+    {
+      continue;
+    }
+
+    auto const found = std::find_if(available.begin(), available.end(), [&check](Memory::Region const& region) {
+      return region.name == check.name && region.size == check.size;
+    });
+
+    if (found == available.end())
+    {
+      *error = "The memory region " + check.name + " changed, its hashes can't be checked";
+      return false;
+    }
+
+    check.region = found - available.begin();
+  }
+
+  _generation = _memory->generation();
+  return true;
+}
+
+void Movie::hashBlocks()
+{
+  auto const begin = std::chrono::steady_clock::now();
+  std::vector<Memory::Region> const& regions = _memory->regions();
+
+  for (auto& check : _checked)
+  {
+    uint8_t const* data;
+    size_t size;
+
+    if (check.state)
+    {
+      _state.resize(_core->serializeSize());
+
+      // A state that can't be saved has no blocks
+      if (_state.empty() || !_core->serialize(_state.data(), _state.size()))
+      {
+        _state.clear();
+      }
+
+      data = _state.data();
+      size = _state.size();
+    }
+    else
+    {
+      data = static_cast<uint8_t const*>(regions[check.region].data);
+      size = regions[check.region].size;
+    }
+
+    check.current.resize((size + kHashBlock - 1) / kHashBlock);
+
+    for (size_t i = 0; i < check.current.size(); i++)
+    {
+      size_t const offset = i * kHashBlock;
+      check.current[i] = static_cast<uint32_t>(hash64(data + offset, std::min<size_t>(kHashBlock, size - offset), 0));
+    }
+  }
+
+  _hashSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+  double const fps = _core->getSystemAVInfo().timing.fps;
+
+  if (++_hashCount >= (fps > 0.0 ? fps : 60.0))
+  {
+    _hashAverage = _hashSum / _hashCount;
+    _hashSum = 0.0;
+    _hashCount = 0;
+  }
+}
+
+void Movie::encodeHashes(bool const full)
+{
+  for (auto& check : _checked)
+  {
+    size_t const count = check.current.size();
+    _changed.clear();
+
+    for (size_t i = 0; i < count; i++)
+    {
+      if (full || i >= check.recorded.size() || check.current[i] != check.recorded[i])
+      {
+        _changed.push_back(i);
+      }
+    }
+
+    putVarint(&_hashes, static_cast<uint32_t>(count));
+    putVarint(&_hashes, static_cast<uint32_t>(_changed.size()));
+
+    size_t previous = 0;
+
+    for (auto const i : _changed)
+    {
+      putVarint(&_hashes, static_cast<uint32_t>(i - previous));
+      put32(&_hashes, check.current[i]);
+      previous = i;
+    }
+
+    check.recorded.swap(check.current);
+  }
+}
+
+bool Movie::decodeHashes(uint64_t const frame, std::string* const error)
+{
+  for (auto& check : _checked)
+  {
+    uint32_t count, changed;
+
+    if (!getVarint(_hashes, &_hashPosition, &count) || !getVarint(_hashes, &_hashPosition, &changed))
+    {
+      *error = "The movie hashes are corrupted";
+      return false;
+    }
+
+    // Don't size the hashes from the file, a region always has the same
+    // number of blocks; the state has none if it couldn't be saved, and a
+    // different number if its size changed, which is a divergence
+    uint64_t const size = check.state ? _core->serializeSize() : check.size;
+    uint64_t const blocks = (size + kHashBlock - 1) / kHashBlock;
+
+    if (count != blocks && (!check.state || count == 0))
+    {
+      *error = "The movie hashes are corrupted";
+      return false;
+    }
+    else if (count != blocks && count != 0)
+    {
+      char message[256];
+      snprintf(message, sizeof(message), "Diverged at frame %llu in %s, %llu bytes instead of about %llu", static_cast<unsigned long long>(frame), check.name.c_str(), static_cast<unsigned long long>(size), static_cast<unsigned long long>(count) * kHashBlock);
+      diverged(message);
+      return true;
+    }
+
+    check.recorded.resize(count);
+    size_t index = 0;
+
+    for (uint32_t i = 0; i < changed; i++)
+    {
+      uint32_t distance;
+
+      if (!getVarint(_hashes, &_hashPosition, &distance) || (index += distance) >= count || _hashes.size() - _hashPosition < 4)
+      {
+        *error = "The movie hashes are corrupted";
+        return false;
+      }
+
+      check.recorded[index] = get32(&_hashes[_hashPosition]);
+      _hashPosition += 4;
+    }
+  }
+
+  return true;
+}
+
+void Movie::compareHashes(uint64_t const frame)
+{
+  for (auto const& check : _checked)
+  {
+    size_t const count = std::max(check.current.size(), check.recorded.size());
+    size_t first = count, last = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      if (i >= check.current.size() || i >= check.recorded.size() || check.current[i] != check.recorded[i])
+      {
+        first = std::min(first, i);
+        last = i;
+      }
+    }
+
+    if (first == count)
+    {
+      continue;
+    }
+
+    // Blocks past the end of the smaller one count as different
+    size_t const size = check.state ? _state.size() : _memory->regions()[check.region].size;
+    size_t const end = last < check.current.size() ? std::min<size_t>((last + 1) * kHashBlock, size) : (last + 1) * kHashBlock;
+
+    char message[256];
+    snprintf(message, sizeof(message), "Diverged at frame %llu in %s, bytes 0x%zx to 0x%zx", static_cast<unsigned long long>(frame), check.name.c_str(), first * kHashBlock, end - 1);
+    diverged(message);
+    return;
+  }
+}
+
+void Movie::diverged(char const* const message)
+{
+  _logger->printf(RETRO_LOG_WARN, "%s", message);
+  _divergence = message;
+  _status = message;
+
+  // Everything after the first divergence would differ too
+  _verify = false;
+}
+
+void Movie::fail(std::string const& message)
+{
+  _logger->printf(RETRO_LOG_ERROR, "%s", message.c_str());
+  _status = message;
+  close();
+}
+
+void Movie::close()
+{
+  if (_file != NULL)
+  {
+    fclose(_file);
+    _file = NULL;
+  }
+
+  _mode = Mode::Idle;
+}
+
+void Movie::setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs)
+{
+  _input->setInputDescriptors(descs);
+}
+
+void Movie::setControllerInfo(std::vector<libretro::ControllerInfo> const& info)
+{
+  _input->setControllerInfo(info);
+}
+
+bool Movie::ctrlUpdated()
+{
+  return _input->ctrlUpdated();
+}
+
+unsigned Movie::getController(unsigned port)
+{
+  return _input->getController(port);
+}
+
+void Movie::poll()
+{
+  _input->poll();
+}
+
+int16_t Movie::read(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+  switch (_mode)
+  {
+  case Mode::Recording:
+  {
+    int16_t const value = _input->read(port, device, index, id);
+    _values.emplace_back(value);
+    return value;
+  }
+
+  case Mode::Playing:
+    if (_cursor < _values.size())
+    {
+      return _values[_cursor++];
+    }
+
+    // Reading past the values counts as a desync when the frame ends
+    _cursor++;
+    return 0;
+
+  case Mode::Idle:
+    break;
+  }
+
+  return _input->read(port, device, index, id);
+}
+
+void Movie::frame(libretro::CoreManager* const core, uint64_t const frame)
+{
+  (void)core;
+
+  char message[128];
+  std::string error;
+
+  switch (_mode)
+  {
+  case Mode::Recording:
+    if (frame != _first + _frames + 1)
+    {
+      // A state was loaded, keep what was recorded up to here
+      snprintf(message, sizeof(message), "The core went from frame %llu to %llu, the recording stopped", static_cast<unsigned long long>(_first + _frames), static_cast<unsigned long long>(frame));
+      _values.clear();
+
+      if (!stop(&error))
+      {
+        fail(error);
+        break;
+      }
+
+      _logger->printf(RETRO_LOG_WARN, "%s", message);
+      _status = message;
+      break;
+    }
+
+    if (_hashed && !resolveRegions(&error))
+    {
+      // Frames without hashes would read as a corrupted movie, keep what was
+      // recorded up to here
+      _values.clear();
+      std::string const reason = error;
+
+      if (!stop(&error))
+      {
+        fail(error);
+        break;
+      }
+
+      _logger->printf(RETRO_LOG_WARN, "%s, the recording stopped", reason.c_str());
+      _status = reason + ", the recording stopped";
+      break;
+    }
+
+    encodeFrame();
+
+    if (_hashed)
+    {
+      hashBlocks();
+      encodeHashes(_count == 1);
+    }
+
+    if (_count == kChunkFrames && !flushFrames(&error))
+    {
+      fail(error);
+    }
+
+    break;
+
+  case Mode::Playing:
+    if (frame != _next)
+    {
+      snprintf(message, sizeof(message), "The core went from frame %llu to %llu, the replay stopped", static_cast<unsigned long long>(_next - 1), static_cast<unsigned long long>(frame));
+      fail(message);
+      break;
+    }
+
+    if (_cursor != _values.size() && _desyncs++ == 0)
+    {
+      _firstDesync = frame;
+    }
+
+    if (_verify && !resolveRegions(&error))
+    {
+      // The replay still works, but can't be checked from here on
+      _logger->printf(RETRO_LOG_WARN, "%s", error.c_str());
+      _status = error;
+      _verify = false;
+    }
+
+    if (_verify)
+    {
+      if (!decodeHashes(frame, &error))
+      {
+        fail(error);
+        break;
+      }
+
+      // Decoding already finds a state whose size changed
+      if (_verify)
+      {
+        hashBlocks();
+        compareHashes(frame);
+      }
+    }
+
+    if (frame == _first + _frames)
+    {
+      snprintf(message, sizeof(message), "The movie ended at frame %llu%s", static_cast<unsigned long long>(frame), _verify ? ", the hashes matched" : "");
+      stop(&error);
+
+      if (_desyncs == 0 && _divergence.empty())
+      {
+        _status = message;
+      }
+
+      _logger->printf(RETRO_LOG_INFO, "%s", message);
+      break;
+    }
+
+    if (!decodeFrame(&error))
+    {
+      fail(error);
+      break;
+    }
+
+    _next++;
+    break;
+
+  case Mode::Idle:
+    break;
+  }
+}
+
+void Movie::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_FILM " Movie"))
+  {
+    ImGui::InputText("File", _path, sizeof(_path));
+
+    std::string error;
+
+    if (!active())
+    {
+      std::vector<Memory::Region> const& regions = _memory->regions();
+
+      if (_uiGeneration != _memory->generation() || _uiRegions.size() != regions.size())
+      {
+        _uiRegions.assign(regions.size(), 1);
+        _uiGeneration = _memory->generation();
+      }
+
+      ImGui::Checkbox("Check memory", &_uiMemory);
+      ImGui::SameLine();
+      ImGui::Checkbox("Check state", &_uiState);
+
+      if (_uiMemory)
+      {
+        ImGui::Indent();
+
+        for (size_t i = 0; i < regions.size(); i++)
+        {
+          bool selected = _uiRegions[i] != 0;
+          ImGui::PushID(static_cast<int>(i));
+
+          if (ImGui::Checkbox(regions[i].name.c_str(), &selected))
+          {
+            _uiRegions[i] = selected;
+          }
+
+          ImGui::PopID();
+        }
+
+        ImGui::Unindent();
+      }
+
+      if (ImGui::Button(ICON_FA_CIRCLE " Record") && running)
+      {
+        std::vector<size_t> checked;
+
+        for (size_t i = 0; _uiMemory && i < regions.size(); i++)
+        {
+          if (_uiRegions[i] != 0)
+          {
+            checked.push_back(i);
+          }
+        }
+
+        _status = record(_path, checked, _uiState, &error) ? "" : error;
+      }
+
+      ImGui::SameLine();
+
+      if (ImGui::Button(ICON_FA_PLAY " Play") && running)
+      {
+        _status = play(_path, &error) ? "" : error;
+      }
+    }
+    else if (ImGui::Button(ICON_FA_STOP " Stop"))
+    {
+      _status.clear();
+
+      if (!stop(&error))
+      {
+        _status = error;
+      }
+    }
+
+    switch (_mode)
+    {
+    case Mode::Recording:
+      ImGui::Text("Recording, %llu frames from frame %llu, %llu bytes", static_cast<unsigned long long>(_frames), static_cast<unsigned long long>(_first), static_cast<unsigned long long>(_offset + _records.size()));
+      break;
+
+    case Mode::Playing:
+      ImGui::Text("Playing, frame %llu of %llu", static_cast<unsigned long long>(_next - 1 - _first), static_cast<unsigned long long>(_frames));
+      break;
+
+    case Mode::Idle:
+      break;
+    }
+
+    if (active() && (recording() ? _hashed : _verify))
+    {
+      double const fps = _core->getSystemAVInfo().timing.fps;
+      double const period = 1000.0 / (fps > 0.0 ? fps : 60.0);
+      ImGui::Text("Hashing %.3f ms per frame, %.2f%% of the frame", _hashAverage, _hashAverage * 100.0 / period);
+    }
+
+    if (!_status.empty())
+    {
+      ImGui::Separator();
+      ImGui::TextUnformatted(_status.c_str());
+    }
+  }
+
+  ImGui::End();
+}
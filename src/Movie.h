@@ -0,0 +1,185 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include "Memory.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * Movie records the input read by the core to a file, and replays it in
+ * place of the real input so that the frames come out exactly the same.
+ * The file starts with the hashes of the core and the content and, unless
+ * the recording started right after the game was loaded, a savestate. Then
+ * come chunks appended as the recording goes, each with the values read by
+ * the core in a run of frames, in the order they were read. An index of the
+ * chunks is appended when the recording stops, and rebuilt by walking the
+ * chunks when it's missing. It sits between the core and the real input
+ * component.
+ *
+ * Optionally, the movie also has hashes of blocks of some memory regions and
+ * of the state after every frame, stored as the blocks that changed since
+ * the previous frame. They're checked while replaying to find the first
+ * frame, and the bytes, where the emulation went a different way.
+ */
+class Movie : public libretro::InputComponent, public libretro::FrameListener
+{
+public:
+  bool init(libretro::CoreManager* core, Memory* memory, libretro::InputComponent* input, libretro::LoggerComponent* logger);
+  void destroy();
+  void reset();
+  void draw(bool running);
+
+  // The files hashed to check that a movie plays on the core and content it
+  // was recorded with.
+  void setContent(std::string const& corePath, std::string const& contentPath);
+
+  // Records from the current frame, from power-on if no frame ran since the
+  // game was loaded. The regions are indices in Memory::regions() whose
+  // hashes are recorded, with the state's if state is true.
+  bool record(char const* const path, std::vector<size_t> const& regions, bool const state, std::string* const error);
+  // Loads the start state of the movie and replays it from the next frame.
+  bool play(char const* const path, std::string* const error);
+  // Moves the replay to after the given frame, which the core must be at.
+  bool seek(uint64_t const frame, std::string* const error);
+  // Ends the recording, writing the index, or the replay.
+  bool stop(std::string* const error);
+
+  bool     active()    const { return _mode != Mode::Idle; }
+  bool     recording() const { return _mode == Mode::Recording; }
+  bool     playing()   const { return _mode == Mode::Playing; }
+  uint64_t first()     const { return _first; }
+  uint64_t frames()    const { return _frames; }
+
+  // libretro::InputComponent
+  virtual void setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs) override;
+
+  virtual void     setControllerInfo(std::vector<libretro::ControllerInfo> const& info) override;
+  virtual bool     ctrlUpdated() override;
+  virtual unsigned getController(unsigned port) override;
+
+  virtual void    poll() override;
+  virtual int16_t read(unsigned port, unsigned device, unsigned index, unsigned id) override;
+
+  // libretro::FrameListener
+  virtual void frame(libretro::CoreManager* const core, uint64_t const frame) override;
+
+protected:
+  enum class Mode
+  {
+    Idle,
+    Recording,
+    Playing
+  };
+
+  enum
+  {
+    kVersion = 1,
+    kChunkFrames = 600,
+    kHashBlock = 1024
+  };
+
+  // A memory region, or the state, whose blocks are hashed every frame. The
+  // hashes are the low 32 bits of hash64.
+  struct Checked
+  {
+    std::string           name;
+    bool                  state;
+    // The index in Memory::regions() of a region with the same name and
+    // size as recorded, for the memory map in _generation.
+    size_t                region;
+    uint64_t              size;
+    std::vector<uint32_t> recorded;
+    std::vector<uint32_t> current;
+  };
+
+  // A chunk of frames, the first being the frame count after it ran.
+  struct Chunk
+  {
+    uint64_t first;
+    uint32_t count;
+    uint64_t offset;
+  };
+
+  bool writeChunk(char const* const tag, void const* const data, size_t const size, std::string* const error);
+  bool flushFrames(std::string* const error);
+  void encodeFrame();
+  void hashBlocks();
+  void encodeHashes(bool const full);
+  bool resolveRegions(std::string* const error);
+
+  bool readChunk(char* const tag, std::vector<uint8_t>* const payload, std::string* const error);
+  bool readIndex(uint64_t const start, std::string* const error);
+  bool loadFrames(size_t const chunk, std::string* const error);
+  bool decodeFrame(std::string* const error);
+  bool decodeHashes(uint64_t const frame, std::string* const error);
+  void compareHashes(uint64_t const frame);
+  void diverged(char const* const message);
+
+  void fail(std::string const& message);
+  void close();
+
+  libretro::CoreManager*     _core;
+  Memory*                    _memory;
+  libretro::InputComponent*  _input;
+  libretro::LoggerComponent* _logger;
+
+  std::string _corePath;
+  std::string _contentPath;
+
+  Mode     _mode;
+  FILE*    _file;
+  uint64_t _offset;
+  // The size of the file when replaying, what chunks say is checked against.
+  uint64_t _size;
+  uint64_t _first;
+  uint64_t _frames;
+  // The frame whose values are in _values when replaying.
+  uint64_t _next;
+
+  std::vector<Chunk> _chunks;
+
+  // The values of the current frame and of the previous one; a frame that
+  // reads the same values as the previous one is stored as a single byte.
+  std::vector<int16_t> _values;
+  std::vector<int16_t> _previous;
+  size_t               _cursor;
+
+  // Records of the chunk being written or replayed.
+  std::vector<uint8_t> _records;
+  uint32_t             _count;
+  size_t               _chunk;
+  size_t               _position;
+  uint32_t             _left;
+
+  // Frames where the core read a different number of values than recorded.
+  uint64_t _desyncs;
+  uint64_t _firstDesync;
+
+  // The movie has hash chunks, and they're compared while replaying until
+  // the first divergence.
+  bool                 _hashed;
+  bool                 _verify;
+  std::vector<Checked> _checked;
+  unsigned             _generation;
+  std::vector<uint8_t> _hashes;
+  size_t               _hashPosition;
+  std::vector<uint8_t> _state;
+  std::vector<size_t>  _changed;
+  std::string          _divergence;
+
+  // Time spent hashing, averaged over a second worth of frames
+  double   _hashSum;
+  unsigned _hashCount;
+  double   _hashAverage;
+
+  char              _path[256];
+  bool              _uiMemory;
+  bool              _uiState;
+  std::vector<char> _uiRegions;
+  unsigned          _uiGeneration;
+  std::string _status;
+};
@@ -0,0 +1,245 @@
+#include "Pattern.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+  enum {
+    // Sample one byte every kSampleStride bytes to estimate byte frequencies
+    kSampleStride = 16,
+    // Above this many distinct anchors a lookup table beats the SIMD compares
+    kMaxSimdAnchors = 16
+  };
+}
+
+static int hexNibble(char const c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
+
+bool Pattern::compile(std::string const& text, std::string* const error) {
+  _bytes.clear();
+  _masks.clear();
+
+  std::string digits;
+
+  for (auto const c : text) {
+    if (c != ' ' && c != '\t') {
+      digits += c;
+    }
+  }
+
+  if (digits.empty() || digits.length() % 2 != 0) {
+    if (error != nullptr) {
+      *error = "Patterns must have two digits per byte";
+    }
+
+    return false;
+  }
+
+  for (size_t i = 0; i < digits.length(); i += 2) {
+    uint8_t byte = 0;
+    uint8_t mask = 0;
+
+    for (size_t j = 0; j < 2; j++) {
+      char const c = digits[i + j];
+      int const nibble = hexNibble(c);
+
+      byte <<= 4;
+      mask <<= 4;
+
+      if (nibble >= 0) {
+        byte |= nibble;
+        mask |= 15;
+      }
+      else if (c != '?') {
+        if (error != nullptr) {
+          *error = std::string("Invalid character '") + c + "' in pattern";
+        }
+
+        _bytes.clear();
+        _masks.clear();
+        return false;
+      }
+    }
+
+    _bytes.emplace_back(byte);
+    _masks.emplace_back(mask);
+  }
+
+  return true;
+}
+
+bool Pattern::matches(uint8_t const* const data) const {
+  size_t const count = _bytes.size();
+
+  for (size_t i = 0; i < count; i++) {
+    if ((data[i] & _masks[i]) != _bytes[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void PatternSearch::add(Pattern const& pattern) {
+  _patterns.emplace_back(pattern);
+}
+
+std::vector<Set> PatternSearch::find(std::vector<Snapshot> const& snapshots) const {
+  std::vector<Anchor> anchors;
+  chooseAnchors(snapshots, &anchors);
+
+  std::vector<std::vector<uint32_t>> results(_patterns.size());
+
+  for (auto const& snapshot : snapshots) {
+    find(snapshot, anchors, &results);
+  }
+
+  std::vector<Set> sets;
+  sets.reserve(results.size());
+
+  for (auto& result : results) {
+    sets.emplace_back(std::move(result));
+  }
+
+  return sets;
+}
+
+void PatternSearch::chooseAnchors(std::vector<Snapshot> const& snapshots, std::vector<Anchor>* const anchors) const {
+  size_t histogram[256];
+  memset(histogram, 0, sizeof(histogram));
+
+  for (auto const& snapshot : snapshots) {
+    uint8_t const* const data = snapshot.data();
+    size_t const size = snapshot.size();
+
+    for (size_t i = 0; i < size; i += kSampleStride) {
+      histogram[data[i]]++;
+    }
+  }
+
+  anchors->clear();
+  anchors->reserve(_patterns.size());
+
+  for (size_t i = 0; i < _patterns.size(); i++) {
+    Pattern const& pattern = _patterns[i];
+    uint8_t const* const bytes = pattern.bytes();
+    uint8_t const* const masks = pattern.masks();
+
+    Anchor anchor;
+    anchor.pattern = i;
+    anchor.offset = pattern.length();
+    anchor.value = 0;
+
+    for (size_t j = 0; j < pattern.length(); j++) {
+      if (masks[j] == 0xff && (anchor.offset == pattern.length() || histogram[bytes[j]] < histogram[anchor.value])) {
+        anchor.offset = j;
+        anchor.value = bytes[j];
+      }
+    }
+
+    // Patterns with only wildcards and nibbles keep offset == length, and are
+    // checked at every position.
+    anchors->emplace_back(anchor);
+  }
+}
+
+void PatternSearch::find(Snapshot const& snapshot,
+                         std::vector<Anchor> const& anchors,
+                         std::vector<std::vector<uint32_t>>* const results) const {
+
+  uint8_t const* const data = snapshot.data();
+  size_t const size = snapshot.size();
+  uint32_t const address = snapshot.address();
+
+  std::vector<Anchor const*> byValue[256];
+  std::vector<uint8_t> values;
+  bool isAnchor[256];
+  memset(isAnchor, 0, sizeof(isAnchor));
+
+  for (auto const& anchor : anchors) {
+    Pattern const& pattern = _patterns[anchor.pattern];
+
+    if (anchor.offset < pattern.length()) {
+      if (!isAnchor[anchor.value]) {
+        isAnchor[anchor.value] = true;
+        values.emplace_back(anchor.value);
+      }
+
+      byValue[anchor.value].emplace_back(&anchor);
+    }
+    else {
+      for (size_t pos = 0; pos + pattern.length() <= size; pos++) {
+        if (pattern.matches(data + pos)) {
+          (*results)[anchor.pattern].emplace_back(address + pos);
+        }
+      }
+    }
+  }
+
+  if (values.empty()) {
+    return;
+  }
+
+  auto const verify = [&](size_t const pos) {
+    for (auto const anchor : byValue[data[pos]]) {
+      Pattern const& pattern = _patterns[anchor->pattern];
+
+      if (pos >= anchor->offset) {
+        size_t const start = pos - anchor->offset;
+
+        if (start + pattern.length() <= size && pattern.matches(data + start)) {
+          (*results)[anchor->pattern].emplace_back(address + start);
+        }
+      }
+    }
+  };
+
+  size_t pos = 0;
+
+#ifdef __SSE2__
+  if (values.size() <= kMaxSimdAnchors) {
+    __m128i needles[kMaxSimdAnchors];
+    size_t const count = values.size();
+
+    for (size_t i = 0; i < count; i++) {
+      needles[i] = _mm_set1_epi8(static_cast<char>(values[i]));
+    }
+
+    for (; pos + 16 <= size; pos += 16) {
+      __m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + pos));
+      __m128i equal = _mm_cmpeq_epi8(block, needles[0]);
+
+      for (size_t i = 1; i < count; i++) {
+        equal = _mm_or_si128(equal, _mm_cmpeq_epi8(block, needles[i]));
+      }
+
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(equal));
+
+      while (mask != 0) {
+        verify(pos + __builtin_ctz(mask));
+        mask &= mask - 1;
+      }
+    }
+  }
+#endif
+
+  for (; pos < size; pos++) {
+    if (isAnchor[data[pos]]) {
+      verify(pos);
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Pattern is an array of bytes where any nibble can be a wildcard, written
+ * as i.e. "8B 45 ?? 3? ?F". Spaces are optional.
+ */
+class Pattern
+{
+public:
+  bool compile(std::string const& text, std::string* const error);
+
+  size_t length() const { return _bytes.size(); }
+  bool matches(uint8_t const* const data) const;
+
+  uint8_t const* bytes() const { return _bytes.data(); }
+  uint8_t const* masks() const { return _masks.data(); }
+
+protected:
+  std::vector<uint8_t> _bytes;
+  std::vector<uint8_t> _masks;
+};
+
+/**
+ * PatternSearch finds many patterns in one pass over the snapshots. Each
+ * pattern is anchored at its rarest fully specified byte, the anchors are
+ * located with SIMD compares and the candidates are then verified.
+ */
+class PatternSearch
+{
+public:
+  void add(Pattern const& pattern);
+
+  // Returns one Set per pattern, in the order they were added.
+  std::vector<Set> find(std::vector<Snapshot> const& snapshots) const;
+
+protected:
+  struct Anchor
+  {
+    size_t  pattern;
+    size_t  offset;
+    uint8_t value;
+  };
+
+  void chooseAnchors(std::vector<Snapshot> const& snapshots, std::vector<Anchor>* const anchors) const;
+
+  void find(Snapshot const& snapshot,
+            std::vector<Anchor> const& anchors,
+            std::vector<std::vector<uint32_t>>* const results) const;
+
+  std::vector<Pattern> _patterns;
+};
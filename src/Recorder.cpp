@@ -0,0 +1,195 @@
+#include "Recorder.h"
+
+#include "imguiext/imguial_fonts.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool Recorder::init(Memory* memory)
+{
+  _memory = memory;
+  _recording = false;
+
+  snprintf(_path, sizeof(_path), "session.chts");
+  snprintf(_sequence, sizeof(_sequence), "3 2 1 0");
+  _repeats = false;
+  _whereAddress = 0;
+  _whereOperator = static_cast<int>(Snapshot::Operator::Equal);
+  _whereValue = 0;
+
+  return true;
+}
+
+void Recorder::destroy()
+{
+  reset();
+  _series.close();
+}
+
+void Recorder::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_DATABASE " Recorder"))
+  {
+    ImGui::InputText("File", _path, sizeof(_path));
+
+    drawRecording(running);
+    ImGui::Separator();
+    drawQueries();
+
+    if (!_status.empty())
+    {
+      ImGui::Separator();
+      ImGui::TextUnformatted(_status.c_str());
+    }
+  }
+
+  ImGui::End();
+}
+
+void Recorder::drawRecording(bool running)
+{
+  if (!_recording)
+  {
+    if (ImGui::Button(ICON_FA_CIRCLE " Record") && running)
+    {
+      start();
+    }
+  }
+  else if (ImGui::Button(ICON_FA_STOP " Stop"))
+  {
+    stop();
+  }
+
+  ImGui::SameLine();
+  ImGui::Text("%u frames, %zu bytes encoded", _recorder.frames(), _recorder.encodedSize());
+}
+
+void Recorder::drawQueries()
+{
+  std::string error;
+
+  if (ImGui::Button(ICON_FA_FOLDER_OPEN " Open"))
+  {
+    _results.clear();
+
+    if (_series.open(_path, &error))
+    {
+      char status[128];
+      snprintf(status, sizeof(status), "%u frames, %zu addresses", _series.frames(), _series.columns());
+      _status = status;
+    }
+    else
+    {
+      _status = error;
+    }
+  }
+
+  ImGui::SameLine();
+
+  if (ImGui::Button(ICON_FA_DOWNLOAD " Export .npy"))
+  {
+    std::string const path = _path;
+
+    if (_series.exportNpy(path + ".values.npy", path + ".addresses.npy", &error))
+    {
+      _status = "Exported " + path + ".values.npy and " + path + ".addresses.npy";
+    }
+    else
+    {
+      _status = error;
+    }
+  }
+
+  ImGui::InputText("Sequence", _sequence, sizeof(_sequence));
+  ImGui::SameLine();
+  ImGui::Checkbox("Repeats", &_repeats);
+  ImGui::SameLine();
+
+  if (ImGui::Button(ICON_FA_SEARCH " Find"))
+  {
+    std::vector<uint8_t> values;
+    char const* str = _sequence;
+
+    for (;;)
+    {
+      char* end;
+      unsigned long const value = strtoul(str, &end, 0);
+
+      if (end == str)
+      {
+        break;
+      }
+
+      values.emplace_back(value);
+      str = end + strspn(end, " ,");
+    }
+
+    Set const found = _series.sequence(values.data(), values.size(), _repeats);
+    _results.assign(found.begin(), found.end());
+  }
+
+  static char const* const operators[] = {"<", "<=", ">", ">=", "==", "!="};
+
+  ImGui::InputInt("Address", &_whereAddress, 1, 16, ImGuiInputTextFlags_CharsHexadecimal);
+  ImGui::Combo("Operator", &_whereOperator, operators, IM_ARRAYSIZE(operators));
+  ImGui::InputInt("Value", &_whereValue);
+
+  if (ImGui::Button(ICON_FA_SEARCH " Constant where"))
+  {
+    auto const op = static_cast<Snapshot::Operator>(_whereOperator);
+    Set const found = _series.constant(_series.where(_whereAddress, op, _whereValue));
+    _results.assign(found.begin(), found.end());
+  }
+
+  ImGui::Text("%zu addresses", _results.size());
+
+  size_t const count = std::min(_results.size(), static_cast<size_t>(256));
+
+  for (size_t i = 0; i < count; i++)
+  {
+    ImGui::Text("%08X", _results[i]);
+  }
+}
+
+void Recorder::start()
+{
+  reset();
+
+  for (auto const& region : _memory->regions())
+  {
+    _recorder.addSource(region.address, region.data, region.size);
+  }
+
+  _recording = true;
+}
+
+void Recorder::stop()
+{
+  std::string error;
+  _recording = false;
+
+  if (_recorder.save(_path, &error))
+  {
+    _status = std::string("Saved ") + _path;
+  }
+  else
+  {
+    _status = error;
+  }
+}
+
+void Recorder::reset()
+{
+  _recorder.reset();
+  _recording = false;
+}
+
+void Recorder::update()
+{
+  if (_recording)
+  {
+    _recorder.capture();
+  }
+}
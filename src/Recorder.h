@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Memory.h"
+#include "TimeSeries.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Recorder captures the memory regions every frame into a TimeSeries file,
+ * and runs queries over recorded sessions.
+ */
+class Recorder
+{
+public:
+  bool init(Memory* memory);
+  void destroy();
+  void draw(bool running);
+
+  void start();
+  void stop();
+  void reset();
+
+  // Must be called once per frame, after the core has run.
+  void update();
+
+protected:
+  void drawRecording(bool running);
+  void drawQueries();
+
+  Memory*            _memory;
+  TimeSeriesRecorder _recorder;
+  TimeSeries         _series;
+  bool               _recording;
+
+  char                  _path[256];
+  char                  _sequence[64];
+  bool                  _repeats;
+  int                   _whereAddress;
+  int                   _whereOperator;
+  int                   _whereValue;
+  std::vector<uint32_t> _results;
+  std::string           _status;
+};
@@ -0,0 +1,446 @@
+#include "Rewind.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool Rewind::init(libretro::CoreManager* core)
+{
+  _core = core;
+  _interval = 0;
+  _budget = 0;
+  _skip = false;
+  _held = false;
+  _dropped = 0;
+  _submitted = 0;
+  _processed = 0;
+  _stateSize = 0;
+  _words = 0;
+  _newestFrame = 0;
+  _hasNewest = false;
+  _capacity = 0;
+  _head = 0;
+  _used = 0;
+
+  _uiEnabled = false;
+  _uiInterval = 1;
+  _uiBudget = 64;
+
+  _quit = false;
+  return true;
+}
+
+void Rewind::destroy()
+{
+  configure(0, 0);
+}
+
+void Rewind::configure(unsigned const interval, size_t const budget)
+{
+  flush();
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _interval = interval;
+
+  if (interval == 0)
+  {
+    stop();
+
+    _pool.clear();
+    _newest.reset();
+    _scratch.clear();
+    _scratch.shrink_to_fit();
+    _ring.reset();
+    _stateSize = 0;
+    _words = 0;
+    _budget = 0;
+    _capacity = 0;
+    clear();
+    return;
+  }
+
+  start();
+
+  if (budget != _budget)
+  {
+    // Not value-initialized, the pages are only touched as the ring fills
+    _ring.reset(new uint8_t[budget]);
+    _budget = budget;
+    _capacity = budget;
+    clear();
+  }
+}
+
+void Rewind::reset()
+{
+  flush();
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Reallocate on the next frame, the next game may have a different size
+    _stateSize = 0;
+    clear();
+  }
+
+  _skip = false;
+  _held = false;
+  _dropped = 0;
+}
+
+void Rewind::allocate(size_t const size)
+{
+  flush();
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // Round up to whole words; the padding is zeroed here and never written by
+  // the core, so it's the same in every state
+  _stateSize = size;
+  _words = (size + 7) / 8;
+
+  _pool.clear();
+
+  for (unsigned i = 0; i < kPoolSize; i++)
+  {
+    _pool.emplace_back(new uint64_t[_words]());
+  }
+
+  _newest.reset(new uint64_t[_words]());
+  _scratch.resize(_words * 8 + 8);
+  clear();
+}
+
+void Rewind::clear()
+{
+  _hasNewest = false;
+  _newestFrame = 0;
+  _head = 0;
+  _used = 0;
+  _deltas.clear();
+}
+
+void Rewind::flush()
+{
+  std::unique_lock<std::mutex> lock(_signal);
+
+  _done.wait(lock, [this]() -> bool {
+    return _processed.load(std::memory_order_acquire) == _submitted;
+  });
+}
+
+void Rewind::start()
+{
+  if (!_worker.joinable())
+  {
+    _quit = false;
+    _worker = std::thread(&Rewind::run, this);
+  }
+}
+
+void Rewind::stop()
+{
+  if (_worker.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(_signal);
+      _quit = true;
+    }
+
+    _wake.notify_one();
+    _worker.join();
+  }
+}
+
+void Rewind::frame(libretro::CoreManager* const core, uint64_t const frame)
+{
+  if (_interval == 0)
+  {
+    return;
+  }
+  else if (_skip)
+  {
+    _skip = false;
+    return;
+  }
+  else if (frame % _interval != 0)
+  {
+    return;
+  }
+
+  size_t const size = core->serializeSize();
+
+  if (size == 0)
+  {
+    return;
+  }
+  else if (size != _stateSize)
+  {
+    allocate(size);
+  }
+
+  if (_submitted - _processed.load(std::memory_order_acquire) == kPoolSize)
+  {
+    // Don't wait for the worker, a state missing here only makes the step
+    // between its neighbours longer
+    _dropped++;
+    return;
+  }
+
+  uint64_t* const state = _pool[_submitted % kPoolSize].get();
+
+  if (!core->serialize(state, size))
+  {
+    return;
+  }
+
+  // There's always room, at most kPoolSize states are in flight
+  _pending.push({state, frame});
+
+  {
+    std::lock_guard<std::mutex> lock(_signal);
+    _submitted++;
+  }
+
+  _wake.notify_one();
+}
+
+bool Rewind::step(std::string* const error)
+{
+  flush();
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (!_hasNewest)
+  {
+    return true;
+  }
+
+  if (!_core->unserialize(_newest.get(), _stateSize, _newestFrame))
+  {
+    char message[128];
+    snprintf(message, sizeof(message), "Error loading the state saved at frame %llu", static_cast<unsigned long long>(_newestFrame));
+    *error = message;
+    return false;
+  }
+
+  if (!_deltas.empty())
+  {
+    Delta const delta = _deltas.back();
+    _deltas.pop_back();
+
+    apply(_ring.get() + delta.offset, delta.size, _newest.get());
+    _newestFrame = delta.frame;
+
+    // The newest delta always ends at the head
+    _head = delta.offset;
+    _used -= delta.size;
+  }
+
+  _skip = true;
+  return true;
+}
+
+void Rewind::run()
+{
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_signal);
+
+      _wake.wait(lock, [this]() -> bool {
+        return _quit || _processed.load(std::memory_order_relaxed) != _submitted;
+      });
+
+      if (_quit)
+      {
+        return;
+      }
+    }
+
+    Pending pending;
+
+    while (_pending.pop(&pending))
+    {
+      store(pending);
+
+      {
+        std::lock_guard<std::mutex> lock(_signal);
+        _processed.fetch_add(1, std::memory_order_release);
+      }
+
+      _done.notify_all();
+    }
+  }
+}
+
+void Rewind::store(Pending const& pending)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (!_hasNewest)
+  {
+    memcpy(_newest.get(), pending.state, _words * 8);
+    _newestFrame = pending.frame;
+    _hasNewest = true;
+    return;
+  }
+
+  size_t const size = encode(pending.state, _newest.get(), _words, _scratch.data());
+  uint64_t const previous = _newestFrame;
+  _newestFrame = pending.frame;
+
+  if (size > _capacity)
+  {
+    // Nothing before the new state can be reached anymore
+    _deltas.clear();
+    _head = 0;
+    _used = 0;
+    return;
+  }
+
+  // Going forward from the head, the deltas are in order from the oldest to
+  // the newest. If the new one doesn't fit before the end of the ring, it
+  // goes at the start, and every delta after the head is dropped since they
+  // are the oldest ones
+  size_t offset = _head;
+
+  if (offset + size > _capacity)
+  {
+    while (!_deltas.empty() && _deltas.front().offset >= offset)
+    {
+      _used -= _deltas.front().size;
+      _deltas.pop_front();
+    }
+
+    offset = 0;
+  }
+
+  while (!_deltas.empty() && _deltas.front().offset >= offset && _deltas.front().offset < offset + size)
+  {
+    _used -= _deltas.front().size;
+    _deltas.pop_front();
+  }
+
+  memcpy(_ring.get() + offset, _scratch.data(), size);
+  _deltas.push_back({previous, offset, size});
+  _head = offset + size;
+  _used += size;
+}
+
+size_t Rewind::encode(uint64_t const* state, uint64_t* newest, size_t const words, uint8_t* out)
+{
+  // Each run is the number of unchanged words and the number of changed
+  // words that follow as two uint32_t, then the XOR of the changed words
+  uint8_t* const begin = out;
+  size_t i = 0;
+
+  while (i < words)
+  {
+    size_t const same = i;
+
+    while (i < words && state[i] == newest[i])
+    {
+      i++;
+    }
+
+    size_t const changed = i;
+
+    while (i < words && state[i] != newest[i])
+    {
+      i++;
+    }
+
+    if (i == changed)
+    {
+      // Only unchanged words up to the end
+      break;
+    }
+
+    uint32_t const header[2] = {static_cast<uint32_t>(changed - same), static_cast<uint32_t>(i - changed)};
+    memcpy(out, header, sizeof(header));
+    out += sizeof(header);
+
+    for (size_t j = changed; j < i; j++)
+    {
+      uint64_t const delta = state[j] ^ newest[j];
+      memcpy(out, &delta, sizeof(delta));
+      out += sizeof(delta);
+      newest[j] = state[j];
+    }
+  }
+
+  return out - begin;
+}
+
+void Rewind::apply(uint8_t const* data, size_t const size, uint64_t* state)
+{
+  uint8_t const* const end = data + size;
+
+  while (data < end)
+  {
+    uint32_t header[2];
+    memcpy(header, data, sizeof(header));
+    data += sizeof(header);
+
+    state += header[0];
+
+    for (uint32_t i = 0; i < header[1]; i++)
+    {
+      uint64_t delta;
+      memcpy(&delta, data, sizeof(delta));
+      data += sizeof(delta);
+      *state++ ^= delta;
+    }
+  }
+}
+
+void Rewind::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_UNDO " Rewind"))
+  {
+    bool changed = ImGui::Checkbox("Enabled", &_uiEnabled);
+    changed = ImGui::InputInt("Frames per state", &_uiInterval) || changed;
+    changed = ImGui::InputInt("Buffer size (MiB)", &_uiBudget) || changed;
+
+    if (_uiInterval < 1)
+    {
+      _uiInterval = 1;
+    }
+
+    if (_uiBudget < 1)
+    {
+      _uiBudget = 1;
+    }
+
+    if (changed)
+    {
+      configure(_uiEnabled ? _uiInterval : 0, static_cast<size_t>(_uiBudget) << 20);
+    }
+
+    ImGui::Button(ICON_FA_BACKWARD " Hold to rewind");
+    _held = running && enabled() && ImGui::IsItemActive();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_hasNewest)
+    {
+      uint64_t const oldest = _deltas.empty() ? _newestFrame : _deltas.front().frame;
+      size_t const raw = (_deltas.size() + 1) * _stateSize;
+      size_t const stored = _used + _stateSize;
+
+      ImGui::Text("%zu states, %llu frames back", _deltas.size() + 1, static_cast<unsigned long long>(_newestFrame - oldest));
+      ImGui::Text("%zu bytes for %zu bytes of states (%.1fx)", stored, raw, static_cast<double>(raw) / stored);
+    }
+    else
+    {
+      ImGui::Text("No state saved");
+    }
+
+    ImGui::Text("%llu states dropped while the worker was busy", static_cast<unsigned long long>(_dropped));
+  }
+
+  ImGui::End();
+}
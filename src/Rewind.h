@@ -0,0 +1,128 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Rewind saves the state of the core every few frames and goes back through
+ * the saved states one per tick. Only the newest state is kept whole, every
+ * older one is the run-length encoded XOR of itself with the state after it,
+ * stored in a ring of fixed size that drops the oldest states when full.
+ * The core serializes into a pool of preallocated buffers on the emulation
+ * thread, a worker thread encodes them. The worker only runs while rewind
+ * is enabled, and sleeps until a state is submitted.
+ */
+class Rewind : public libretro::FrameListener
+{
+public:
+  bool init(libretro::CoreManager* core);
+  void destroy();
+  void draw(bool running);
+
+  // Saves a state every interval frames in a ring of budget bytes, interval
+  // 0 stops saving and frees everything.
+  void configure(unsigned const interval, size_t const budget);
+  void reset();
+
+  bool enabled()   const { return _interval != 0; }
+  bool rewinding() const { return _held; }
+
+  // Loads the newest saved state and drops it, so that the next call loads
+  // the one before it; the oldest state is loaded again and again. Does
+  // nothing if there's no saved state. The next frame isn't saved, so that
+  // it can be run to show the loaded state.
+  bool step(std::string* const error);
+
+  // libretro::FrameListener
+  virtual void frame(libretro::CoreManager* const core, uint64_t const frame) override;
+
+protected:
+  enum
+  {
+    kPoolSize = 8
+  };
+
+  struct Pending
+  {
+    uint64_t* state;
+    uint64_t  frame;
+  };
+
+  // Takes the newest state back to the state saved at frame.
+  struct Delta
+  {
+    uint64_t frame;
+    size_t   offset;
+    size_t   size;
+  };
+
+  void allocate(size_t const size);
+  void clear();
+  // Waits until the worker has encoded every submitted state.
+  void flush();
+
+  void start();
+  void stop();
+  void run();
+  void store(Pending const& pending);
+
+  // Writes the runs of words that differ between state and newest, and
+  // copies state into newest; returns the number of bytes written to out,
+  // at most words * 8 + 8.
+  static size_t encode(uint64_t const* state, uint64_t* newest, size_t const words, uint8_t* out);
+  static void   apply(uint8_t const* data, size_t const size, uint64_t* state);
+
+  libretro::CoreManager* _core;
+
+  unsigned _interval;
+  size_t   _budget;
+  bool     _skip;
+  bool     _held;
+  uint64_t _dropped;
+
+  // Buffers are used in turn, the one for submission n is free again once
+  // the worker has processed submission n
+  std::vector<std::unique_ptr<uint64_t[]>> _pool;
+  SpscQueue<Pending, kPoolSize>            _pending;
+  uint64_t                                 _submitted;
+  std::atomic<uint64_t>                    _processed;
+
+  // _signal is only held to change _submitted, _processed and _quit, so
+  // that waiting on the condition variables can't miss a change
+  std::thread             _worker;
+  std::mutex              _signal;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  bool                    _quit;
+
+  // Everything below is guarded by _mutex
+  std::mutex _mutex;
+  size_t     _stateSize;
+  size_t     _words;
+
+  std::unique_ptr<uint64_t[]> _newest;
+  uint64_t                    _newestFrame;
+  bool                        _hasNewest;
+  std::vector<uint8_t>        _scratch;
+
+  std::unique_ptr<uint8_t[]> _ring;
+  size_t                     _capacity;
+  size_t                     _head;
+  size_t                     _used;
+  std::deque<Delta>          _deltas;
+
+  bool _uiEnabled;
+  int  _uiInterval;
+  int  _uiBudget;
+};
@@ -0,0 +1,325 @@
+#include "RunAhead.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <chrono>
+
+bool RunAhead::Mute::setRate(double rate)
+{
+  (void)rate;
+  return true;
+}
+
+void RunAhead::Mute::mix(const int16_t* samples, size_t frames)
+{
+  (void)samples;
+  (void)frames;
+}
+
+std::string const& RunAhead::ConfigView::getCoreAssetsDirectory()
+{
+  return config->getCoreAssetsDirectory();
+}
+
+std::string const& RunAhead::ConfigView::getSaveDirectory()
+{
+  return config->getSaveDirectory();
+}
+
+std::string const& RunAhead::ConfigView::getSystemPath()
+{
+  return config->getSystemPath();
+}
+
+void RunAhead::ConfigView::setVariables(std::vector<libretro::Variable> const& variables)
+{
+  (void)variables;
+}
+
+bool RunAhead::ConfigView::varUpdated()
+{
+  return false;
+}
+
+std::string const& RunAhead::ConfigView::getVariable(std::string const& variable)
+{
+  return config->getVariable(variable);
+}
+
+void RunAhead::InputView::setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs)
+{
+  (void)descs;
+}
+
+void RunAhead::InputView::setControllerInfo(std::vector<libretro::ControllerInfo> const& info)
+{
+  (void)info;
+}
+
+bool RunAhead::InputView::ctrlUpdated()
+{
+  return true;
+}
+
+unsigned RunAhead::InputView::getController(unsigned port)
+{
+  return input->getController(port);
+}
+
+void RunAhead::InputView::poll()
+{
+  input->poll();
+}
+
+int16_t RunAhead::InputView::read(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+  return input->read(port, device, index, id);
+}
+
+bool RunAhead::init(libretro::LoggerComponent* logger,
+                    libretro::ConfigComponent* config,
+                    libretro::VideoComponent* video,
+                    libretro::InputComponent* input,
+                    libretro::LoaderComponent* loader,
+                    libretro::CoreManager* core)
+{
+  _logger = logger;
+  _config = config;
+  _video = video;
+  _input = input;
+  _loader = loader;
+  _core = core;
+
+  _configView.config = config;
+  _inputView.input = input;
+
+  _frames = 0;
+  _second = false;
+  _secondaryLoaded = false;
+
+  _uiFrames = 0;
+  _uiSecond = false;
+
+  reset();
+  return true;
+}
+
+void RunAhead::destroy()
+{
+  reset();
+}
+
+void RunAhead::reset()
+{
+  stopSecondary();
+
+  _corePath.clear();
+  _gamePath.clear();
+  _state.clear();
+
+  // The second instance is for the game that was running
+  _second = false;
+  _uiSecond = false;
+
+  _sum = Costs{0.0, 0.0, 0.0, 0.0};
+  _average = _sum;
+  _count = 0;
+  _status.clear();
+}
+
+void RunAhead::setContent(std::string const& corePath, std::string const& gamePath)
+{
+  _corePath = corePath;
+  _gamePath = gamePath;
+}
+
+bool RunAhead::startSecondary(std::string* const error)
+{
+  if (_corePath.empty())
+  {
+    *error = "No game is loaded";
+    return false;
+  }
+
+  _secondary.init(_logger, &_configView, _video, &_mute, &_inputView, _loader);
+
+  // Whatever the failure, the private copy of the core must not outlive it,
+  // _secondaryLoaded stays false and stopSecondary won't release it
+  if (!_secondary.loadCore(_corePath, true))
+  {
+    _secondary.destroy();
+    *error = "Error loading a private copy of the core";
+    return false;
+  }
+
+  if (!_secondary.loadGame(_gamePath))
+  {
+    _secondary.destroy();
+    *error = "Error loading the game in the second instance";
+    return false;
+  }
+
+  _secondaryLoaded = true;
+  return true;
+}
+
+void RunAhead::stopSecondary()
+{
+  if (_secondaryLoaded)
+  {
+    _secondary.destroy();
+    _secondaryLoaded = false;
+  }
+}
+
+void RunAhead::fail(std::string const& message)
+{
+  _logger->printf(RETRO_LOG_ERROR, "Run-ahead disabled: %s", message.c_str());
+
+  _frames = 0;
+  _uiFrames = 0;
+  _status = message;
+}
+
+void RunAhead::step()
+{
+  typedef std::chrono::steady_clock Clock;
+
+  if (_frames == 0)
+  {
+    _core->step();
+    return;
+  }
+
+  auto const begin = Clock::now();
+  _core->stepWithoutVideo();
+  auto const stepped = Clock::now();
+
+  size_t const size = _core->serializeSize();
+  _state.resize(size);
+
+  if (size == 0 || !_core->serialize(_state.data(), size))
+  {
+    fail("The core doesn't support savestates");
+    return;
+  }
+
+  auto const saved = Clock::now();
+  uint64_t const frame = _core->getFrameCount();
+  double load;
+  double ahead;
+
+  if (_second)
+  {
+    if (!_secondary.unserialize(_state.data(), size, frame))
+    {
+      fail("Error loading the state in the second instance");
+      return;
+    }
+
+    auto const loaded = Clock::now();
+    _secondary.runAhead(_frames);
+    auto const end = Clock::now();
+
+    load = std::chrono::duration<double, std::milli>(loaded - saved).count();
+    ahead = std::chrono::duration<double, std::milli>(end - loaded).count();
+  }
+  else
+  {
+    _core->runAhead(_frames);
+    auto const ran = Clock::now();
+
+    if (!_core->unserialize(_state.data(), size, frame))
+    {
+      fail("Error loading the state");
+      return;
+    }
+
+    auto const end = Clock::now();
+
+    ahead = std::chrono::duration<double, std::milli>(ran - saved).count();
+    load = std::chrono::duration<double, std::milli>(end - ran).count();
+  }
+
+  _sum.frame += std::chrono::duration<double, std::milli>(stepped - begin).count();
+  _sum.save += std::chrono::duration<double, std::milli>(saved - stepped).count();
+  _sum.ahead += ahead;
+  _sum.load += load;
+
+  double const fps = _core->getSystemAVInfo().timing.fps;
+
+  if (++_count >= (fps > 0.0 ? fps : 60.0))
+  {
+    _average = Costs{_sum.frame / _count, _sum.save / _count, _sum.ahead / _count, _sum.load / _count};
+    _sum = Costs{0.0, 0.0, 0.0, 0.0};
+    _count = 0;
+  }
+}
+
+void RunAhead::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_STEP_FORWARD " Run-ahead"))
+  {
+    bool changed = ImGui::InputInt("Frames", &_uiFrames);
+    changed = ImGui::Checkbox("Second instance", &_uiSecond) || changed;
+
+    if (_uiFrames < 0)
+    {
+      _uiFrames = 0;
+    }
+    else if (_uiFrames > kMaxFrames)
+    {
+      _uiFrames = kMaxFrames;
+    }
+
+    if (changed)
+    {
+      std::string error;
+      _status.clear();
+
+      if (_uiSecond && _uiFrames != 0 && !_secondaryLoaded && !startSecondary(&error))
+      {
+        _status = error;
+        _uiSecond = false;
+      }
+      else if (!_uiSecond)
+      {
+        stopSecondary();
+      }
+
+      _frames = _uiFrames;
+      _second = _uiSecond && _secondaryLoaded;
+      _sum = Costs{0.0, 0.0, 0.0, 0.0};
+      _average = _sum;
+      _count = 0;
+    }
+
+    if (running && _frames != 0)
+    {
+      double const fps = _core->getSystemAVInfo().timing.fps;
+      double const period = 1000.0 / (fps > 0.0 ? fps : 60.0);
+      double const each = _average.ahead / _frames;
+      double const fixed = _average.frame + _average.save + _average.load;
+      double const total = fixed + _average.ahead;
+
+      ImGui::Separator();
+      ImGui::Text("Real frame %.3f ms, save %.3f ms, load %.3f ms", _average.frame, _average.save, _average.load);
+      ImGui::Text("%u frames ahead %.3f ms (%.3f ms each)", _frames, _average.ahead, each);
+      ImGui::Text("Total %.3f ms, %.0f%% of the %.3f ms frame", total, total * 100.0 / period, period);
+
+      if (each > 0.0 && fixed < period)
+      {
+        ImGui::Text("Up to %d frames ahead fit in a frame", static_cast<int>((period - fixed) / each));
+      }
+    }
+
+    if (!_status.empty())
+    {
+      ImGui::Separator();
+      ImGui::TextUnformatted(_status.c_str());
+    }
+  }
+
+  ImGui::End();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * RunAhead hides the input lag of the core by showing, every frame, the
+ * frame the core would show some frames later if the input stayed the same.
+ * The real frame runs with its audio but without its video, then the core
+ * runs ahead with only the last frame shown, and is taken back to the real
+ * frame by loading a state saved after it. In second instance mode a private
+ * copy of the core runs ahead instead, so that the real core's audio never
+ * goes through a state load.
+ */
+class RunAhead
+{
+public:
+  bool init(libretro::LoggerComponent* logger,
+            libretro::ConfigComponent* config,
+            libretro::VideoComponent* video,
+            libretro::InputComponent* input,
+            libretro::LoaderComponent* loader,
+            libretro::CoreManager* core);
+
+  void destroy();
+  void reset();
+  void draw(bool running);
+
+  // The paths to load the second instance from.
+  void setContent(std::string const& corePath, std::string const& gamePath);
+
+  bool enabled() const { return _frames != 0; }
+
+  // Runs the next frame in place of CoreManager::step().
+  void step();
+
+protected:
+  enum
+  {
+    kMaxFrames = 8
+  };
+
+  class Mute : public libretro::AudioComponent
+  {
+  public:
+    virtual bool setRate(double rate) override;
+    virtual void mix(const int16_t* samples, size_t frames) override;
+  };
+
+  // The second instance shares the configuration of the real core, but
+  // doesn't change it, and keeps the options it was loaded with.
+  class ConfigView : public libretro::ConfigComponent
+  {
+  public:
+    libretro::ConfigComponent* config;
+
+    virtual std::string const& getCoreAssetsDirectory() override;
+    virtual std::string const& getSaveDirectory() override;
+    virtual std::string const& getSystemPath() override;
+
+    virtual void setVariables(std::vector<libretro::Variable> const& variables) override;
+    virtual bool varUpdated() override;
+    virtual std::string const& getVariable(std::string const& variable) override;
+  };
+
+  // The second instance reads the same input as the real core. The real core
+  // takes the notification when a device is plugged, so the second instance
+  // checks the devices every frame.
+  class InputView : public libretro::InputComponent
+  {
+  public:
+    libretro::InputComponent* input;
+
+    virtual void setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs) override;
+
+    virtual void     setControllerInfo(std::vector<libretro::ControllerInfo> const& info) override;
+    virtual bool     ctrlUpdated() override;
+    virtual unsigned getController(unsigned port) override;
+
+    virtual void    poll() override;
+    virtual int16_t read(unsigned port, unsigned device, unsigned index, unsigned id) override;
+  };
+
+  // Milliseconds spent in each part of a frame.
+  struct Costs
+  {
+    double frame;
+    double save;
+    double ahead;
+    double load;
+  };
+
+  bool startSecondary(std::string* const error);
+  void stopSecondary();
+  void fail(std::string const& message);
+
+  libretro::LoggerComponent* _logger;
+  libretro::ConfigComponent* _config;
+  libretro::VideoComponent*  _video;
+  libretro::InputComponent*  _input;
+  libretro::LoaderComponent* _loader;
+  libretro::CoreManager*     _core;
+
+  std::string _corePath;
+  std::string _gamePath;
+
+  unsigned             _frames;
+  bool                 _second;
+  std::vector<uint8_t> _state;
+
+  libretro::CoreManager _secondary;
+  Mute                  _mute;
+  ConfigView            _configView;
+  InputView             _inputView;
+  bool                  _secondaryLoaded;
+
+  // Summed over a second worth of frames, then averaged
+  Costs    _sum;
+  unsigned _count;
+  Costs    _average;
+
+  int         _uiFrames;
+  bool        _uiSecond;
+  std::string _status;
+};
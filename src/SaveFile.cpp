@@ -0,0 +1,94 @@
+#include "SaveFile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::string savePath(std::string const& directory, std::string const& gamePath, char const* const extension)
+{
+  std::string path = directory;
+
+  if (!path.empty() && path.back() != '/' && path.back() != '\\')
+  {
+    path += '/';
+  }
+
+  size_t const separator = gamePath.find_last_of("/\\");
+  std::string name = gamePath.substr(separator == std::string::npos ? 0 : separator + 1);
+  size_t const dot = name.rfind('.');
+
+  if (dot != std::string::npos && dot != 0)
+  {
+    name.erase(dot);
+  }
+
+  return path + name + extension;
+}
+
+bool replaceFile(std::string const& path, void const* const data, size_t const size, std::string* const error)
+{
+  std::string const temporary = path + ".tmp";
+  FILE* const file = fopen(temporary.c_str(), "wb");
+
+  if (file == NULL)
+  {
+    *error = "Error creating " + temporary + ": " + strerror(errno);
+    return false;
+  }
+
+  // The data must be on the disk before the rename makes it the file
+  bool ok = fwrite(data, 1, size, file) == size && fflush(file) == 0;
+
+#ifdef _WIN32
+  ok = ok && _commit(_fileno(file)) == 0;
+#else
+  ok = ok && fsync(fileno(file)) == 0;
+#endif
+
+  int const saved = errno;
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok)
+  {
+    *error = "Error writing " + temporary + ": " + strerror(saved);
+    remove(temporary.c_str());
+    return false;
+  }
+
+#ifdef _WIN32
+  ok = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  ok = rename(temporary.c_str(), path.c_str()) == 0;
+
+  if (ok)
+  {
+    // Make the rename itself durable
+    size_t const separator = path.rfind('/');
+    std::string const directory = separator == std::string::npos ? "." : path.substr(0, separator + 1);
+    int const fd = open(directory.c_str(), O_RDONLY);
+
+    if (fd >= 0)
+    {
+      fsync(fd);
+      close(fd);
+    }
+  }
+#endif
+
+  if (!ok)
+  {
+    *error = "Error replacing " + path + ": " + strerror(errno);
+    remove(temporary.c_str());
+    return false;
+  }
+
+  return true;
+}
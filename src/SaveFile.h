@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// The path of the file in directory named after the game, without the
+// game's directory and extension, with extension appended.
+std::string savePath(std::string const& directory, std::string const& gamePath, char const* const extension);
+
+// Writes data to a temporary file next to path, syncs it, and renames it
+// over path, so that a crash leaves either the old file or the new one.
+bool replaceFile(std::string const& path, void const* const data, size_t const size, std::string* const error);
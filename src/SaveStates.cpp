@@ -0,0 +1,519 @@
+#include "SaveStates.h"
+#include "Compress.h"
+#include "Hash.h"
+#include "SaveFile.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <chrono>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// The file is a header with a magic, the version, the frame count when the
+// state was saved, the size of the state and its hash64, all little endian,
+// followed by the compressed state.
+static size_t const kHeaderSize = 32;
+
+static void put(uint8_t* const out, uint64_t const value, unsigned const bytes)
+{
+  for (unsigned i = 0; i < bytes; i++)
+  {
+    out[i] = static_cast<uint8_t>(value >> (i * 8));
+  }
+}
+
+static uint64_t get(uint8_t const* const data, unsigned const bytes)
+{
+  uint64_t value = 0;
+
+  for (unsigned i = 0; i < bytes; i++)
+  {
+    value |= static_cast<uint64_t>(data[i]) << (i * 8);
+  }
+
+  return value;
+}
+
+bool SaveStates::init(libretro::LoggerComponent* logger, libretro::ConfigComponent* config, libretro::CoreManager* core)
+{
+  _logger = logger;
+  _config = config;
+  _core = core;
+
+  for (unsigned i = 0; i < kPoolSize; i++)
+  {
+    _free[i] = true;
+  }
+
+  _queued = 0;
+  _readFrame = 0;
+  _readSlot = -1;
+  _reading = false;
+  _readOk = false;
+  _pendingLoad = -1;
+
+  _uiSlot = 0;
+  _uiSave = false;
+  _uiLoad = false;
+
+  _quit = false;
+  _worker = std::thread(&SaveStates::run, this);
+  return true;
+}
+
+void SaveStates::destroy()
+{
+  reset();
+
+  {
+    std::lock_guard<std::mutex> lock(_signal);
+    _quit = true;
+  }
+
+  _wake.notify_one();
+  _worker.join();
+}
+
+void SaveStates::reset()
+{
+  // Let the saves in flight reach the disk
+  flush();
+
+  for (unsigned i = 0; i < kPoolSize; i++)
+  {
+    _pool[i].clear();
+    _pool[i].shrink_to_fit();
+  }
+
+  _read.clear();
+  _read.shrink_to_fit();
+  _readSlot = -1;
+  _readOk = false;
+  _pendingLoad = -1;
+
+  _gamePath.clear();
+  _uiSave = false;
+  _uiLoad = false;
+  _status.clear();
+}
+
+void SaveStates::setContent(std::string const& gamePath)
+{
+  _gamePath = gamePath;
+}
+
+std::string SaveStates::path(unsigned const slot) const
+{
+  return savePath(_config->getSaveDirectory(), _gamePath, (".state" + std::to_string(slot)).c_str());
+}
+
+bool SaveStates::save(unsigned const slot, std::string* const error)
+{
+  if (_gamePath.empty())
+  {
+    *error = "No game is loaded";
+    return false;
+  }
+
+  size_t const size = _core->serializeSize();
+
+  if (size == 0)
+  {
+    *error = "The core doesn't support savestates";
+    return false;
+  }
+
+  unsigned buffer = 0;
+
+  while (buffer < kPoolSize && !_free[buffer])
+  {
+    buffer++;
+  }
+
+  if (buffer == kPoolSize)
+  {
+    // Don't wait for the disk on the emulation thread
+    *error = "Still writing the previous savestates, try again";
+    return false;
+  }
+
+  // Only allocates the first time, or when the state grows
+  _pool[buffer].resize(size);
+
+  if (!_core->serialize(_pool[buffer].data(), size))
+  {
+    *error = "Error saving the state";
+    return false;
+  }
+
+  // A read of the slot that is in flight or done is now stale
+  if (_readSlot == static_cast<int>(slot))
+  {
+    _readSlot = -1;
+  }
+
+  submit({Type::Save, slot, buffer, size, _core->getFrameCount(), path(slot)});
+  _free[buffer] = false;
+  return true;
+}
+
+bool SaveStates::load(unsigned const slot, std::string* const error)
+{
+  if (_gamePath.empty())
+  {
+    *error = "No game is loaded";
+    return false;
+  }
+
+  if (!_reading && _readSlot == static_cast<int>(slot))
+  {
+    if (!_readOk)
+    {
+      *error = _readMessage;
+      return false;
+    }
+
+    apply(slot);
+    return true;
+  }
+
+  // Reads it in update when the read in flight is done
+  _pendingLoad = slot;
+  prefetch(slot);
+  return true;
+}
+
+void SaveStates::prefetch(unsigned const slot)
+{
+  if (_reading || _gamePath.empty())
+  {
+    return;
+  }
+
+  submit({Type::Read, slot, 0, _core->serializeSize(), 0, path(slot)});
+  _reading = true;
+  _readSlot = slot;
+}
+
+void SaveStates::apply(unsigned const slot)
+{
+  char message[128];
+
+  if (_core->unserialize(_read.data(), _read.size(), _readFrame))
+  {
+    snprintf(message, sizeof(message), "Loaded slot %u", slot);
+  }
+  else
+  {
+    snprintf(message, sizeof(message), "Error loading the state in slot %u", slot);
+    _logger->printf(RETRO_LOG_ERROR, "%s", message);
+  }
+
+  _status = message;
+  _pendingLoad = -1;
+}
+
+void SaveStates::submit(Job const& job)
+{
+  {
+    std::lock_guard<std::mutex> lock(_signal);
+
+    // There's always room, there are at most kPoolSize saves and a read queued
+    _jobs.push(job);
+  }
+
+  _wake.notify_one();
+  _queued++;
+}
+
+void SaveStates::finish(Result const& result)
+{
+  _queued--;
+
+  if (result.type == Type::Save)
+  {
+    _free[result.buffer] = true;
+
+    if (!result.ok)
+    {
+      _logger->printf(RETRO_LOG_ERROR, "%s", result.message.c_str());
+    }
+
+    _status = result.message;
+    return;
+  }
+
+  _reading = false;
+
+  if (_readSlot != static_cast<int>(result.slot))
+  {
+    // The slot was saved while it was being read
+    return;
+  }
+
+  _readOk = result.ok;
+  _readMessage = result.message;
+}
+
+void SaveStates::flush()
+{
+  while (_queued != 0)
+  {
+    Result result;
+
+    {
+      std::unique_lock<std::mutex> lock(_signal);
+      _done.wait(lock, [this]() -> bool { return _results.size() != 0; });
+      _results.pop(&result);
+    }
+
+    finish(result);
+  }
+}
+
+void SaveStates::update()
+{
+  Result result;
+
+  while (_results.pop(&result))
+  {
+    finish(result);
+  }
+
+  std::string error;
+
+  if (_uiSave)
+  {
+    _uiSave = false;
+
+    if (!save(_uiSlot, &error))
+    {
+      _status = error;
+    }
+  }
+
+  if (_uiLoad)
+  {
+    _uiLoad = false;
+
+    if (!load(_uiSlot, &error))
+    {
+      _status = error;
+    }
+  }
+
+  if (_reading || _gamePath.empty())
+  {
+    return;
+  }
+
+  if (_pendingLoad >= 0)
+  {
+    if (_readSlot != _pendingLoad)
+    {
+      prefetch(_pendingLoad);
+    }
+    else if (_readOk)
+    {
+      apply(_pendingLoad);
+    }
+    else
+    {
+      _status = _readMessage;
+      _pendingLoad = -1;
+    }
+  }
+  else if (_readSlot != _uiSlot)
+  {
+    prefetch(_uiSlot);
+  }
+}
+
+void SaveStates::run()
+{
+  for (;;)
+  {
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(_signal);
+      _wake.wait(lock, [this]() -> bool { return _quit || _jobs.size() != 0; });
+
+      if (!_jobs.pop(&job))
+      {
+        return;
+      }
+    }
+
+    Result result = {job.type, job.slot, job.buffer, false, std::string()};
+
+    if (job.type == Type::Save)
+    {
+      write(job, &result);
+    }
+    else
+    {
+      read(job, &result);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_signal);
+
+      // There's always room, there are never more results than jobs queued
+      _results.push(result);
+    }
+
+    _done.notify_one();
+  }
+}
+
+void SaveStates::write(Job const& job, Result* const result)
+{
+  auto const begin = std::chrono::steady_clock::now();
+  uint8_t const* const state = _pool[job.buffer].data();
+
+  _compressed.resize(kHeaderSize + compressBound(job.size));
+  memcpy(_compressed.data(), "CHST", 4);
+  put(_compressed.data() + 4, kVersion, 4);
+  put(_compressed.data() + 8, job.frame, 8);
+  put(_compressed.data() + 16, job.size, 8);
+  put(_compressed.data() + 24, hash64(state, job.size, 0), 8);
+
+  size_t const size = kHeaderSize + compress(state, job.size, _compressed.data() + kHeaderSize);
+
+  if (!replaceFile(job.path, _compressed.data(), size, &result->message))
+  {
+    return;
+  }
+
+  double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+  char message[128];
+  snprintf(message, sizeof(message), "Saved slot %u, %zu KiB in %zu KiB, in %.1f ms", job.slot, job.size >> 10, size >> 10, ms);
+
+  result->ok = true;
+  result->message = message;
+}
+
+void SaveStates::read(Job const& job, Result* const result)
+{
+  char message[256];
+  FILE* const file = fopen(job.path.c_str(), "rb");
+
+  if (file == NULL)
+  {
+    if (errno == ENOENT)
+    {
+      snprintf(message, sizeof(message), "Slot %u is empty", job.slot);
+    }
+    else
+    {
+      snprintf(message, sizeof(message), "Error opening %s: %s", job.path.c_str(), strerror(errno));
+    }
+
+    result->message = message;
+    return;
+  }
+
+  bool ok = fseek(file, 0, SEEK_END) == 0;
+  long const size = ok ? ftell(file) : -1;
+  ok = ok && size >= static_cast<long>(kHeaderSize) && fseek(file, 0, SEEK_SET) == 0;
+
+  if (ok)
+  {
+    _compressed.resize(size);
+    ok = fread(_compressed.data(), 1, size, file) == static_cast<size_t>(size);
+  }
+
+  fclose(file);
+
+  if (!ok)
+  {
+    snprintf(message, sizeof(message), "Error reading %s", job.path.c_str());
+    result->message = message;
+    return;
+  }
+
+  uint8_t const* const header = _compressed.data();
+
+  if (memcmp(header, "CHST", 4) != 0 || get(header + 4, 4) != kVersion)
+  {
+    snprintf(message, sizeof(message), "%s isn't a savestate", job.path.c_str());
+    result->message = message;
+    return;
+  }
+
+  if (job.size == 0)
+  {
+    result->message = "The core doesn't support savestates";
+    return;
+  }
+
+  // Don't allocate what the header says before checking it: the state
+  // can't be larger than the core's, and each compressed byte expands to
+  // at most 255 bytes
+  uint64_t const stateSize = get(header + 16, 8);
+  ok = stateSize != 0 && stateSize <= job.size && stateSize / 255 <= static_cast<uint64_t>(size) - kHeaderSize;
+
+  if (ok)
+  {
+    _read.resize(stateSize);
+    ok = decompress(header + kHeaderSize, size - kHeaderSize, _read.data(), _read.size()) &&
+         hash64(_read.data(), _read.size(), 0) == get(header + 24, 8);
+  }
+
+  if (!ok)
+  {
+    snprintf(message, sizeof(message), "The savestate in slot %u is corrupted", job.slot);
+    result->message = message;
+    return;
+  }
+
+  _readFrame = get(header + 8, 8);
+  result->ok = true;
+}
+
+void SaveStates::draw(bool running)
+{
+  (void)running;
+
+  if (ImGui::Begin(ICON_FA_FLOPPY_O " Savestates"))
+  {
+    ImGui::SliderInt("Slot", &_uiSlot, 0, kSlots - 1);
+
+    if (ImGui::Button(ICON_FA_DOWNLOAD " Save"))
+    {
+      _uiSave = true;
+    }
+
+    ImGui::SameLine();
+
+    if (ImGui::Button(ICON_FA_UPLOAD " Load"))
+    {
+      _uiLoad = true;
+    }
+
+    if (!_gamePath.empty())
+    {
+      if (_reading)
+      {
+        ImGui::Text("Reading slot %d", _readSlot);
+      }
+      else if (_readSlot == _uiSlot)
+      {
+        ImGui::TextUnformatted(_readOk ? "Ready to load" : _readMessage.c_str());
+      }
+
+      ImGui::Text("%u writes in flight", _queued - (_reading ? 1 : 0));
+    }
+
+    if (!_status.empty())
+    {
+      ImGui::Separator();
+      ImGui::TextUnformatted(_status.c_str());
+    }
+  }
+
+  ImGui::End();
+}
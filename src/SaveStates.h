@@ -0,0 +1,129 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include "SpscQueue.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * SaveStates keeps numbered savestate slots in the save directory. The core
+ * serializes into a pool of preallocated buffers on the emulation thread,
+ * and an I/O thread compresses them and writes them to a temporary file
+ * that is synced and renamed over the slot's file, so that a crash leaves
+ * either the old state or the new one. The selected slot is read and
+ * decompressed ahead of time, so that loading it only has to unserialize.
+ */
+class SaveStates
+{
+public:
+  bool init(libretro::LoggerComponent* logger, libretro::ConfigComponent* config, libretro::CoreManager* core);
+  void destroy();
+  void reset();
+  void draw(bool running);
+
+  // The game whose slots are used.
+  void setContent(std::string const& gamePath);
+
+  // Must be called on the emulation thread between frames. Saving never
+  // waits for the disk, and fails if too many saves are already waiting.
+  // Loading unserializes right away if the slot was read ahead of time, and
+  // after the read in a later update otherwise.
+  bool save(unsigned const slot, std::string* const error);
+  bool load(unsigned const slot, std::string* const error);
+
+  // Must be called on the emulation thread between frames. Takes what the
+  // I/O thread finished, runs what was asked in the UI, and reads the
+  // selected slot ahead of time.
+  void update();
+
+protected:
+  enum
+  {
+    kSlots = 10,
+    kPoolSize = 4,
+    kVersion = 1
+  };
+
+  enum class Type
+  {
+    Save,
+    Read
+  };
+
+  struct Job
+  {
+    Type        type;
+    unsigned    slot;
+    unsigned    buffer;
+    // For reads, the core's state size, which a valid state can't exceed
+    size_t      size;
+    uint64_t    frame;
+    std::string path;
+  };
+
+  struct Result
+  {
+    Type        type;
+    unsigned    slot;
+    unsigned    buffer;
+    bool        ok;
+    std::string message;
+  };
+
+  std::string path(unsigned const slot) const;
+  void prefetch(unsigned const slot);
+  void apply(unsigned const slot);
+  void submit(Job const& job);
+  void finish(Result const& result);
+  void flush();
+
+  void run();
+  void write(Job const& job, Result* const result);
+  void read(Job const& job, Result* const result);
+
+  libretro::LoggerComponent* _logger;
+  libretro::ConfigComponent* _config;
+  libretro::CoreManager*     _core;
+
+  std::string _gamePath;
+
+  // Owned by the emulation thread, except the buffers and the read ahead
+  // state while a job with them is queued
+  std::vector<uint8_t> _pool[kPoolSize];
+  bool                 _free[kPoolSize];
+  unsigned             _queued;
+
+  std::vector<uint8_t> _read;
+  uint64_t             _readFrame;
+  int                  _readSlot;
+  bool                 _reading;
+  bool                 _readOk;
+  std::string          _readMessage;
+  int                  _pendingLoad;
+
+  // Pushing to the queues and setting _quit hold _signal, so that waiting
+  // on the condition variables can't miss them
+  SpscQueue<Job, 16>      _jobs;
+  SpscQueue<Result, 16>   _results;
+  std::mutex              _signal;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+  bool                    _quit;
+  std::thread             _worker;
+
+  // Owned by the I/O thread
+  std::vector<uint8_t> _compressed;
+
+  // Asked in the UI, run in update
+  int  _uiSlot;
+  bool _uiSave;
+  bool _uiLoad;
+
+  std::string _status;
+};
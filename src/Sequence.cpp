@@ -0,0 +1,220 @@
+#include "Sequence.h"
+#include "Value.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+  struct Input {
+    uint8_t const*     data;
+    uint8_t const*     previous;
+    Snapshot::Operator op;
+    bool               relative;
+    uint32_t           value;
+  };
+}
+
+template<size_t S, Snapshot::Format F>
+static inline bool matchOne(Input const& input, size_t const offset) {
+  uint32_t const v1 = read<S, F>(input.data + offset);
+  uint32_t const v2 = input.relative ? read<S, F>(input.previous + offset) : input.value;
+  return compare(input.op, v1, v2);
+}
+
+#ifdef __SSE2__
+static inline __m128i byteSwap(__m128i v) {
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+  v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+// Same as the scalar BCD conversion, nibbles above 9 included.
+static inline __m128i fromBcd(__m128i const v) {
+  __m128i const nibbles = _mm_set1_epi8(0x0f);
+  __m128i const lo = _mm_and_si128(v, nibbles);
+  __m128i const hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibbles);
+
+  // Each byte is at most 15 * 10 + 15, so the 16-bit multiply can't carry
+  // between bytes
+  __m128i const bytes = _mm_add_epi16(_mm_mullo_epi16(hi, _mm_set1_epi16(10)), lo);
+
+  __m128i const words = _mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(bytes, 8), _mm_set1_epi16(100)),
+                                      _mm_and_si128(bytes, _mm_set1_epi16(0xff)));
+
+  return _mm_madd_epi16(words, _mm_set1_epi32(10000 << 16 | 1));
+}
+
+// v has four 32-bit lanes loaded in memory order.
+template<size_t S, Snapshot::Format F>
+static inline __m128i convert4(__m128i v) {
+  __m128i const mask = _mm_set1_epi32(S == 4 ? -1 : static_cast<int>((UINT32_C(1) << (S * 8)) - 1));
+
+  switch (F) {
+    case Snapshot::Format::UIntLittleEndian:
+      return _mm_and_si128(v, mask);
+
+    case Snapshot::Format::UIntBigEndian:
+      return _mm_srli_epi32(byteSwap(v), (4 - S) * 8);
+
+    case Snapshot::Format::BCDLittleEndian:
+      return fromBcd(_mm_and_si128(v, mask));
+
+    case Snapshot::Format::BCDBigEndian:
+      return fromBcd(_mm_srli_epi32(byteSwap(v), (4 - S) * 8));
+  }
+
+  return v;
+}
+
+// Returns one bit per lane.
+static inline unsigned compare4(Snapshot::Operator const op, __m128i v1, __m128i v2) {
+  // SSE2 only has signed compares, flipping the sign bits gives the
+  // unsigned order
+  __m128i const bias = _mm_set1_epi32(static_cast<int>(UINT32_C(0x80000000)));
+  v1 = _mm_xor_si128(v1, bias);
+  v2 = _mm_xor_si128(v2, bias);
+
+  switch (op) {
+    case Snapshot::Operator::LessThan:     return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v2, v1)));
+    case Snapshot::Operator::LessEqual:    return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v1, v2))) & 15;
+    case Snapshot::Operator::GreaterThan:  return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v1, v2)));
+    case Snapshot::Operator::GreaterEqual: return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v2, v1))) & 15;
+    case Snapshot::Operator::Equal:        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v1, v2)));
+    case Snapshot::Operator::NotEqual:     return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v1, v2))) & 15;
+  }
+
+  return 0;
+}
+
+// Tests the 16 addresses starting at offset, reading 19 bytes. Each load at
+// offset + phase has the values of the addresses offset + phase + 4 * lane.
+template<size_t S, Snapshot::Format F>
+static inline unsigned match16(Input const& input, size_t const offset) {
+  static uint16_t const spread[16] = {
+    0x0000, 0x0001, 0x0010, 0x0011, 0x0100, 0x0101, 0x0110, 0x0111,
+    0x1000, 0x1001, 0x1010, 0x1011, 0x1100, 0x1101, 0x1110, 0x1111
+  };
+
+  __m128i const value = _mm_set1_epi32(static_cast<int>(input.value));
+  unsigned bits = 0;
+
+  for (unsigned phase = 0; phase < 4; phase++) {
+    __m128i const v1 = convert4<S, F>(_mm_loadu_si128(reinterpret_cast<__m128i const*>(input.data + offset + phase)));
+    __m128i const v2 = input.relative ? convert4<S, F>(_mm_loadu_si128(reinterpret_cast<__m128i const*>(input.previous + offset + phase))) : value;
+
+    bits |= spread[compare4(input.op, v1, v2)] << phase;
+  }
+
+  return bits;
+}
+#endif
+
+template<size_t S, Snapshot::Format F>
+static void match(std::vector<Input> const& inputs, size_t const size, uint32_t const address, std::vector<uint32_t>* const result) {
+  if (size < S) {
+    return;
+  }
+
+  size_t const last = size - S + 1;
+
+  for (size_t base = 0; base < last; base += 64) {
+    size_t const count = std::min(last - base, static_cast<size_t>(64));
+    uint64_t mask = count == 64 ? ~UINT64_C(0) : (UINT64_C(1) << count) - 1;
+
+    // Go through all steps for each block of 64 addresses so that the data
+    // of all snapshots is read while it's hot, stopping at the first step
+    // that leaves no candidates
+    for (auto const& input : inputs) {
+      uint64_t keep = 0;
+
+      for (unsigned sub = 0; sub < count; sub += 16) {
+        unsigned const want = mask >> sub & 0xffff;
+        size_t const offset = base + sub;
+
+        if (want == 0) {
+          continue;
+        }
+
+#ifdef __SSE2__
+        if (offset + 19 <= size) {
+          keep |= static_cast<uint64_t>(match16<S, F>(input, offset)) << sub;
+          continue;
+        }
+#endif
+
+        for (unsigned i = 0; i < 16 && sub + i < count; i++) {
+          if ((want >> i & 1) != 0) {
+            keep |= static_cast<uint64_t>(matchOne<S, F>(input, offset + i)) << (sub + i);
+          }
+        }
+      }
+
+      mask &= keep;
+
+      if (mask == 0) {
+        break;
+      }
+    }
+
+    for (unsigned i = 0; mask != 0; i++, mask >>= 1) {
+      if ((mask & 1) != 0) {
+        result->emplace_back(address + base + i);
+      }
+    }
+  }
+}
+
+template<size_t S>
+static void match(Snapshot::Format const format, std::vector<Input> const& inputs, size_t const size, uint32_t const address, std::vector<uint32_t>* const result) {
+  switch (format) {
+    case Snapshot::Format::UIntLittleEndian: match<S, Snapshot::Format::UIntLittleEndian>(inputs, size, address, result); break;
+    case Snapshot::Format::UIntBigEndian:    match<S, Snapshot::Format::UIntBigEndian>(inputs, size, address, result); break;
+    case Snapshot::Format::BCDLittleEndian:  match<S, Snapshot::Format::BCDLittleEndian>(inputs, size, address, result); break;
+    case Snapshot::Format::BCDBigEndian:     match<S, Snapshot::Format::BCDBigEndian>(inputs, size, address, result); break;
+  }
+}
+
+Set Sequence::match(Snapshot::Size const bits,
+                    Snapshot::Format const format,
+                    std::vector<Snapshot> const& snapshots,
+                    std::vector<Step> const& steps) {
+
+  std::vector<uint32_t> result;
+
+  if (snapshots.empty() || snapshots.size() != steps.size()) {
+    return Set(std::move(result));
+  }
+
+  uint32_t const address = snapshots[0].address();
+  size_t size = snapshots[0].size();
+  std::vector<Input> inputs;
+
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    if (snapshots[i].address() != address) {
+      return Set(std::move(result));
+    }
+
+    size = std::min(size, snapshots[i].size());
+
+    Input input;
+    input.data = snapshots[i].data();
+    input.previous = i != 0 ? snapshots[i - 1].data() : nullptr;
+    input.op = steps[i].op;
+    input.relative = i != 0 && steps[i].relative;
+    input.value = steps[i].value;
+
+    inputs.emplace_back(input);
+  }
+
+  switch (bits) {
+    case Snapshot::Size::_8:  ::match<1>(format, inputs, size, address, &result); break;
+    case Snapshot::Size::_16: ::match<2>(format, inputs, size, address, &result); break;
+    case Snapshot::Size::_24: ::match<3>(format, inputs, size, address, &result); break;
+    case Snapshot::Size::_32: ::match<4>(format, inputs, size, address, &result); break;
+  }
+
+  return Set(std::move(result));
+}
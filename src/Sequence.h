@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Sequence finds the addresses whose values went through a known history,
+ * i.e. it was 3, then 2, then 1, checking all snapshots in a single pass
+ * instead of filtering each one and intersecting the results.
+ */
+class Sequence
+{
+public:
+  struct Step
+  {
+    Snapshot::Operator op;
+    // Compare to the value in the previous snapshot instead of value. The
+    // first step is always compared to value.
+    bool               relative;
+    uint32_t           value;
+  };
+
+  // There must be one step per snapshot, and all snapshots must be of the
+  // same region.
+  static Set match(Snapshot::Size const bits,
+                   Snapshot::Format const format,
+                   std::vector<Snapshot> const& snapshots,
+                   std::vector<Step> const& steps);
+};
@@ -0,0 +1,384 @@
+#include "Session.h"
+#include "Value.h"
+
+#include "imgui/imgui.h"
+#include "imguiext/imguial_fonts.h"
+
+#include <chrono>
+#include <stdio.h>
+
+bool Session::init(libretro::CoreManager* core, libretro::InputComponent* input, Memory* memory)
+{
+  _core = core;
+  _input = input;
+  _memory = memory;
+
+  _uiInterval = 600;
+  _address = 0;
+  _bits = static_cast<int>(Snapshot::Size::_8);
+  _format = static_cast<int>(Snapshot::Format::UIntLittleEndian);
+  _operator = static_cast<int>(Snapshot::Operator::NotEqual);
+  _value = 0;
+
+  reset();
+  return true;
+}
+
+void Session::destroy()
+{
+  reset();
+}
+
+bool Session::start(unsigned const interval, std::string* const error)
+{
+  reset();
+
+  _interval = interval != 0 ? interval : 1;
+  _first = _core->getFrameCount();
+  _starts.emplace_back(0);
+
+  if (!addKeyframe(_first))
+  {
+    *error = "The core doesn't support savestates";
+    reset();
+    return false;
+  }
+
+  _mode = Mode::Recording;
+  return true;
+}
+
+void Session::stop()
+{
+  _mode = Mode::Idle;
+}
+
+void Session::reset()
+{
+  _mode = Mode::Idle;
+  _interval = 1;
+  _first = 0;
+  _cursor = 0;
+  _inputs.clear();
+  _starts.clear();
+  _keyframes.clear();
+  _stateBytes = 0;
+}
+
+bool Session::addKeyframe(uint64_t const frame)
+{
+  size_t const size = _core->serializeSize();
+
+  if (size == 0)
+  {
+    return false;
+  }
+
+  Keyframe keyframe;
+  keyframe.frame = frame;
+  keyframe.state.resize(size);
+
+  if (!_core->serialize(keyframe.state.data(), size))
+  {
+    return false;
+  }
+
+  _stateBytes += size;
+  _keyframes.emplace_back(std::move(keyframe));
+  return true;
+}
+
+bool Session::restore(Keyframe const& keyframe, std::string* const error)
+{
+  if (!_core->unserialize(keyframe.state.data(), keyframe.state.size(), keyframe.frame))
+  {
+    char message[128];
+    snprintf(message, sizeof(message), "Error loading the keyframe at frame %llu", static_cast<unsigned long long>(keyframe.frame));
+    *error = message;
+    return false;
+  }
+
+  _cursor = _starts[keyframe.frame - _first];
+  return true;
+}
+
+bool Session::bisect(std::function<bool()> const& predicate, bool* const found, uint64_t* const frame, std::string* const error)
+{
+  *found = false;
+
+  if (_keyframes.empty())
+  {
+    *error = "Nothing was recorded";
+    return false;
+  }
+
+  // Save the current state to come back to it at the end
+  Keyframe current;
+  current.frame = _core->getFrameCount();
+  current.state.resize(_core->serializeSize());
+
+  if (!_core->serialize(current.state.data(), current.state.size()))
+  {
+    *error = "Error saving the current state";
+    return false;
+  }
+
+  Mode const mode = _mode;
+  size_t const cursor = _cursor;
+
+  _mode = Mode::Replaying;
+  bool ok = search(predicate, found, frame, error);
+
+  if (!_core->unserialize(current.state.data(), current.state.size(), current.frame) && ok)
+  {
+    *error = "Error restoring the current state";
+    ok = false;
+  }
+
+  _mode = mode;
+  _cursor = cursor;
+  return ok;
+}
+
+bool Session::search(std::function<bool()> const& predicate, bool* const found, uint64_t* const frame, std::string* const error)
+{
+  if (!restore(_keyframes[0], error))
+  {
+    return false;
+  }
+
+  if (predicate())
+  {
+    *found = true;
+    *frame = _first;
+    return true;
+  }
+
+  // The predicate is false at lo and true at hi, with hi == size() standing
+  // for somewhere after the last keyframe, if at all
+  size_t lo = 0, hi = _keyframes.size();
+
+  while (hi - lo > 1)
+  {
+    size_t const mid = lo + (hi - lo) / 2;
+
+    if (!restore(_keyframes[mid], error))
+    {
+      return false;
+    }
+
+    if (predicate())
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid;
+    }
+  }
+
+  uint64_t const end = hi < _keyframes.size() ? _keyframes[hi].frame : _first + frames();
+
+  if (!restore(_keyframes[lo], error))
+  {
+    return false;
+  }
+
+  while (_core->getFrameCount() < end)
+  {
+    // The frame listeners don't see replayed frames, they'd take them for
+    // new ones
+    _core->replayFrame();
+
+    // Resynchronize with the recording in case the core read a different
+    // number of inputs this time
+    size_t const index = _core->getFrameCount() - _first;
+    _cursor = index < _starts.size() ? _starts[index] : _inputs.size();
+
+    if (predicate())
+    {
+      *found = true;
+      *frame = _core->getFrameCount();
+      return true;
+    }
+  }
+
+  if (hi < _keyframes.size())
+  {
+    *error = "The replay didn't reproduce the recorded session, the core may not be deterministic";
+    return false;
+  }
+
+  return true;
+}
+
+void Session::setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs)
+{
+  _input->setInputDescriptors(descs);
+}
+
+void Session::setControllerInfo(std::vector<libretro::ControllerInfo> const& info)
+{
+  _input->setControllerInfo(info);
+}
+
+bool Session::ctrlUpdated()
+{
+  return _input->ctrlUpdated();
+}
+
+unsigned Session::getController(unsigned port)
+{
+  return _input->getController(port);
+}
+
+void Session::poll()
+{
+  _input->poll();
+}
+
+int16_t Session::read(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+  switch (_mode)
+  {
+  case Mode::Recording:
+  {
+    int16_t const value = _input->read(port, device, index, id);
+    _inputs.emplace_back(value);
+    return value;
+  }
+
+  case Mode::Replaying:
+    return _cursor < _inputs.size() ? _inputs[_cursor++] : 0;
+
+  case Mode::Idle:
+    break;
+  }
+
+  return _input->read(port, device, index, id);
+}
+
+void Session::frame(libretro::CoreManager* const core, uint64_t const frame)
+{
+  (void)core;
+
+  switch (_mode)
+  {
+  case Mode::Recording:
+    _starts.emplace_back(_inputs.size());
+
+    if ((frame - _first) % _interval == 0 && !addKeyframe(frame))
+    {
+      _status = "Error saving a keyframe, recording stopped";
+      _mode = Mode::Idle;
+    }
+
+    break;
+
+  case Mode::Replaying:
+  case Mode::Idle:
+    break;
+  }
+}
+
+void Session::draw(bool running)
+{
+  if (ImGui::Begin(ICON_FA_HISTORY " Session"))
+  {
+    std::string error;
+
+    if (!recording())
+    {
+      if (ImGui::Button(ICON_FA_CIRCLE " Record") && running)
+      {
+        if (start(_uiInterval, &error))
+        {
+          _status.clear();
+        }
+        else
+        {
+          _status = error;
+        }
+      }
+    }
+    else if (ImGui::Button(ICON_FA_STOP " Stop"))
+    {
+      stop();
+    }
+
+    ImGui::SameLine();
+    ImGui::InputInt("Keyframe interval", &_uiInterval);
+
+    if (_uiInterval < 1)
+    {
+      _uiInterval = 1;
+    }
+
+    ImGui::Text("%llu frames, %zu keyframes, %zu bytes", static_cast<unsigned long long>(frames()), _keyframes.size(), _stateBytes + _inputs.size() * sizeof(int16_t));
+
+    ImGui::Separator();
+    drawBisect();
+
+    if (!_status.empty())
+    {
+      ImGui::Separator();
+      ImGui::TextUnformatted(_status.c_str());
+    }
+  }
+
+  ImGui::End();
+}
+
+void Session::drawBisect()
+{
+  static char const* const sizes[] = {"8 bits", "16 bits", "24 bits", "32 bits"};
+  static char const* const formats[] = {"Little endian", "Big endian", "BCD little endian", "BCD big endian"};
+  static char const* const operators[] = {"<", "<=", ">", ">=", "==", "!="};
+
+  ImGui::InputInt("Address", &_address, 1, 16, ImGuiInputTextFlags_CharsHexadecimal);
+  ImGui::Combo("Size", &_bits, sizes, IM_ARRAYSIZE(sizes));
+  ImGui::Combo("Format", &_format, formats, IM_ARRAYSIZE(formats));
+  ImGui::Combo("Operator", &_operator, operators, IM_ARRAYSIZE(operators));
+  ImGui::InputInt("Value", &_value);
+
+  if (ImGui::Button(ICON_FA_SEARCH " Find first frame"))
+  {
+    uint32_t const address = _address;
+    auto const bits = static_cast<Snapshot::Size>(_bits);
+    auto const format = static_cast<Snapshot::Format>(_format);
+    auto const op = static_cast<Snapshot::Operator>(_operator);
+    uint32_t const value = _value;
+
+    auto const predicate = [&]() -> bool {
+      uint32_t current;
+      return _memory->peek(address, bits, format, &current) && compare(op, current, value);
+    };
+
+    auto const begin = std::chrono::steady_clock::now();
+
+    std::string error;
+    bool found;
+    uint64_t frame;
+
+    if (bisect(predicate, &found, &frame, &error))
+    {
+      double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+      char status[128];
+
+      if (found)
+      {
+        snprintf(status, sizeof(status), "First true after frame %llu (%.0f ms)", static_cast<unsigned long long>(frame), ms);
+      }
+      else
+      {
+        snprintf(status, sizeof(status), "Never true in the recorded frames (%.0f ms)", ms);
+      }
+
+      _status = status;
+    }
+    else
+    {
+      _status = error;
+    }
+  }
+}
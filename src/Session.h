@@ -0,0 +1,95 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include "Memory.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Session records the input read by the core every frame, along with a
+ * savestate every few frames, so that any recorded frame can be reached
+ * again by loading the previous keyframe and replaying the input from there.
+ * It sits between the core and the real input component.
+ */
+class Session : public libretro::InputComponent, public libretro::FrameListener
+{
+public:
+  bool init(libretro::CoreManager* core, libretro::InputComponent* input, Memory* memory);
+  void destroy();
+  void draw(bool running);
+
+  bool start(unsigned const interval, std::string* const error);
+  void stop();
+  void reset();
+
+  bool     recording() const { return _mode == Mode::Recording; }
+  uint64_t frames() const { return _starts.empty() ? 0 : _starts.size() - 1; }
+
+  // Finds the first recorded frame after which the predicate is true. The
+  // keyframes are binary searched, so the predicate must stay true once it
+  // becomes true, like a flag being set. found is false if it's never true.
+  // The core is back at its current state when this returns.
+  bool bisect(std::function<bool()> const& predicate, bool* const found, uint64_t* const frame, std::string* const error);
+
+  // libretro::InputComponent
+  virtual void setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs) override;
+
+  virtual void     setControllerInfo(std::vector<libretro::ControllerInfo> const& info) override;
+  virtual bool     ctrlUpdated() override;
+  virtual unsigned getController(unsigned port) override;
+
+  virtual void    poll() override;
+  virtual int16_t read(unsigned port, unsigned device, unsigned index, unsigned id) override;
+
+  // libretro::FrameListener
+  virtual void frame(libretro::CoreManager* const core, uint64_t const frame) override;
+
+protected:
+  enum class Mode
+  {
+    Idle,
+    Recording,
+    Replaying
+  };
+
+  struct Keyframe
+  {
+    uint64_t             frame;
+    std::vector<uint8_t> state;
+  };
+
+  bool addKeyframe(uint64_t const frame);
+  bool restore(Keyframe const& keyframe, std::string* const error);
+  bool search(std::function<bool()> const& predicate, bool* const found, uint64_t* const frame, std::string* const error);
+
+  void drawBisect();
+
+  libretro::CoreManager*    _core;
+  libretro::InputComponent* _input;
+  Memory*                   _memory;
+
+  Mode     _mode;
+  unsigned _interval;
+  uint64_t _first;
+  size_t   _cursor;
+
+  // Values returned to the core in the order it read them, and the index of
+  // the first value read by each frame; _starts[i] is where frame
+  // _first + i + 1 begins.
+  std::vector<int16_t>  _inputs;
+  std::vector<size_t>   _starts;
+  std::vector<Keyframe> _keyframes;
+  size_t                _stateBytes;
+
+  int         _uiInterval;
+  int         _address;
+  int         _bits;
+  int         _format;
+  int         _operator;
+  int         _value;
+  std::string _status;
+};
@@ -10,6 +10,11 @@ Set::Set(std::vector<uint32_t>&& elements) : _elements(std::move(elements)) {
 
 Set::Set(Set&& other) : _elements(std::move(other._elements)) {}
 
+Set& Set::operator=(Set&& other) {
+  _elements = std::move(other._elements);
+  return *this;
+}
+
 bool Set::contains(uint32_t element) const
 {
   return std::binary_search(_elements.begin(), _elements.end(), element);
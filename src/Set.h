@@ -11,7 +11,11 @@ public:
   Set(std::vector<uint32_t>&& elements);
   Set(Set&& other);
 
+  Set& operator=(Set&& other);
+
   bool contains(uint32_t element) const;
+  size_t size() const { return _elements.size(); }
+  bool empty() const { return _elements.empty(); }
 
   Set union_(const Set& other);
   Set intersection(const Set& other);
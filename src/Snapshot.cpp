@@ -1,4 +1,5 @@
 #include "Snapshot.h"
+#include "Value.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -7,48 +8,14 @@ Snapshot::Snapshot(uint32_t const address, const void* const data, size_t const
   _address = address;
   _size = size;
 
-  _data = malloc(size);
-  memcpy(_data, data, size);
+  _data = std::shared_ptr<uint8_t>(new uint8_t[size], std::default_delete<uint8_t[]>());
+  memcpy(_data.get(), data, size);
 }
 
-template<Snapshot::Operator O>
-static bool compare(uint32_t const v1, uint32_t const v2) {
-  switch (O) {
-  case Snapshot::Operator::LessThan:     return v1 < v2;
-  case Snapshot::Operator::LessEqual:    return v1 <= v2;
-  case Snapshot::Operator::GreaterThan:  return v1 > v2;
-  case Snapshot::Operator::GreaterEqual: return v1 >= v2;
-  case Snapshot::Operator::Equal:        return v1 == v2;
-  case Snapshot::Operator::NotEqual:     return v1 != v2;
-  }
-}
-
-template<Snapshot::Format F>
-static uint32_t convert(uint32_t v) {
-  switch (F) {
-    case Snapshot::Format::UIntLittleEndian:
-      return (v >> 24 & UINT32_C(0x000000ff)) |
-             (v >>  8 & UINT32_C(0x0000ff00)) |
-             (v <<  8 & UINT32_C(0x00ff0000)) |
-             (v << 24 & UINT32_C(0xff000000));
-
-    case Snapshot::Format::UIntBigEndian:
-      return v;
-
-    case Snapshot::Format::BCDLittleEndian:
-      v = convert<Snapshot::Format::UIntLittleEndian>(v);
-      // fallthrough
-
-    case Snapshot::Format::BCDBigEndian:
-      return (v >>  0 & 15) * UINT32_C(       1) +
-             (v >>  4 & 15) * UINT32_C(      10) +
-             (v >>  8 & 15) * UINT32_C(     100) +
-             (v >> 12 & 15) * UINT32_C(    1000) +
-             (v >> 16 & 15) * UINT32_C(   10000) +
-             (v >> 20 & 15) * UINT32_C(  100000) +
-             (v >> 24 & 15) * UINT32_C( 1000000) +
-             (v >> 28 & 15) * UINT32_C(10000000);
-  }
+Snapshot::Snapshot(uint32_t const address, std::shared_ptr<uint8_t> const& data, size_t const size) {
+  _address = address;
+  _data = data;
+  _size = size;
 }
 
 template<size_t S, Snapshot::Format F, Snapshot::Operator O>
@@ -77,7 +44,7 @@ static Set filter(uint32_t address, void const* const data, size_t const size, u
   }
 
   for (;;) {
-    if (compare<O>(convert<F>(current), value)) {
+    if (compare<O>(convert<S, F>(current), value)) {
       result.emplace_back(address);
     }
 
@@ -162,7 +129,7 @@ static Set filter(Snapshot::Size const bits,
 }
 
 Set Snapshot::filter(Size const bits, Format const format, Operator const op, uint32_t const value) const {
-  return ::filter(bits, format, op, _address, _data, _size, value);
+  return ::filter(bits, format, op, _address, _data.get(), _size, value);
 }
 
 template<size_t S, Snapshot::Format F, Snapshot::Operator O>
@@ -196,7 +163,7 @@ static Set filter(uint32_t address, size_t const size, void const* const data1,
   }
 
   for (;;) {
-    if (compare<O>(convert<F>(current1), convert<F>(current2))) {
+    if (compare<O>(convert<S, F>(current1), convert<S, F>(current2))) {
       result.emplace_back(address);
     }
 
@@ -291,5 +258,5 @@ static Set filter(Snapshot::Size const bits,
 }
 
 Set Snapshot::filter(Size const bits, Format const format, Operator const op, Snapshot const& other) const {
-  return ::filter(bits, format, op, _address, _data, _size, other._address, other._data, other._size);
+  return ::filter(bits, format, op, _address, _data.get(), _size, other._address, other._data.get(), other._size);
 }
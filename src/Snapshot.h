@@ -2,6 +2,7 @@
 
 #include "Set.h"
 
+#include <memory>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -35,15 +36,18 @@ public:
   };
 
   Snapshot(uint32_t const address, const void* const data, size_t const size);
+  // Uses data as is instead of copying it.
+  Snapshot(uint32_t const address, std::shared_ptr<uint8_t> const& data, size_t const size);
 
   uint32_t address() const { return _address; }
   size_t size() const { return _size; }
+  uint8_t const* data() const { return _data.get(); }
 
   Set filter(Size const bits, Format const format, Operator const op, uint32_t const value) const;
   Set filter(Size const bits, Format const format, Operator const op, Snapshot const& other) const;
 
 protected:
   uint32_t _address;
-  void* _data;
+  std::shared_ptr<uint8_t> _data;
   size_t _size;
 };
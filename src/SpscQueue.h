@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * A bounded lock-free queue for exactly one producer thread and one
+ * consumer thread. N must be a power of two.
+ */
+template<typename T, size_t N>
+class SpscQueue
+{
+public:
+  SpscQueue() : _items(N), _head(0), _tail(0) {}
+
+  // Returns false without blocking if the queue is full.
+  bool push(T const& item) {
+    size_t const tail = _tail.load(std::memory_order_relaxed);
+
+    if (tail - _head.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+
+    _items[tail & (N - 1)] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false without blocking if the queue is empty.
+  bool pop(T* const item) {
+    size_t const head = _head.load(std::memory_order_relaxed);
+
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    *item = _items[head & (N - 1)];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+  }
+
+protected:
+  static_assert(N != 0 && (N & (N - 1)) == 0, "The capacity must be a power of two");
+
+  std::vector<T> _items;
+
+  // Keep the indices in different cache lines so that the threads don't
+  // invalidate each other's line on every operation
+  alignas(64) std::atomic<size_t> _head;
+  alignas(64) std::atomic<size_t> _tail;
+};
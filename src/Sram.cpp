@@ -0,0 +1,216 @@
+#include "Sram.h"
+#include "Hash.h"
+#include "SaveFile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+bool Sram::init(libretro::LoggerComponent* logger, libretro::ConfigComponent* config, libretro::CoreManager* core)
+{
+  _logger = logger;
+  _config = config;
+  _core = core;
+
+  _savedHash = 0;
+  _writtenHash = 0;
+  _writing = false;
+
+  _quit = false;
+  _worker = std::thread(&Sram::run, this);
+  return true;
+}
+
+void Sram::destroy()
+{
+  reset();
+
+  {
+    std::lock_guard<std::mutex> lock(_signal);
+    _quit = true;
+  }
+
+  _wake.notify_one();
+  _worker.join();
+}
+
+void Sram::reset()
+{
+  flush();
+
+  _path.clear();
+  _copy.clear();
+  _copy.shrink_to_fit();
+}
+
+void Sram::setContent(std::string const& gamePath)
+{
+  void* const data = _core->getMemoryData(RETRO_MEMORY_SAVE_RAM);
+  size_t const size = _core->getMemorySize(RETRO_MEMORY_SAVE_RAM);
+
+  if (data == NULL || size == 0)
+  {
+    // The game has no save RAM
+    return;
+  }
+
+  _path = savePath(_config->getSaveDirectory(), gamePath, ".srm");
+  FILE* const file = fopen(_path.c_str(), "rb");
+
+  if (file != NULL)
+  {
+    // A file of a different size is loaded as far as it goes, like other
+    // frontends do
+    size_t const count = fread(data, 1, size, file);
+    bool const longer = fgetc(file) != EOF;
+    fclose(file);
+
+    if (count != size || longer)
+    {
+      _logger->printf(RETRO_LOG_WARN, "%s doesn't have the %zu bytes of the save RAM", _path.c_str(), size);
+    }
+    else
+    {
+      _logger->printf(RETRO_LOG_INFO, "Loaded the save RAM from %s", _path.c_str());
+    }
+  }
+  else if (errno != ENOENT)
+  {
+    _logger->printf(RETRO_LOG_ERROR, "Error opening %s: %s", _path.c_str(), strerror(errno));
+  }
+
+  // Only written when it changes from what is in the file
+  _savedHash = hash64(data, size, 0);
+  _checked = Clock::now();
+}
+
+void Sram::finish(Result const& result)
+{
+  _writing = false;
+
+  if (result.ok)
+  {
+    _savedHash = _writtenHash;
+    _logger->printf(RETRO_LOG_DEBUG, "Wrote the save RAM to %s", _path.c_str());
+  }
+  else
+  {
+    // Tried again at the next check
+    _logger->printf(RETRO_LOG_ERROR, "%s", result.message.c_str());
+  }
+}
+
+void Sram::flush()
+{
+  if (_writing)
+  {
+    Result result;
+
+    {
+      std::unique_lock<std::mutex> lock(_signal);
+      _done.wait(lock, [this]() -> bool { return _results.size() != 0; });
+      _results.pop(&result);
+    }
+
+    finish(result);
+  }
+
+  if (_path.empty())
+  {
+    return;
+  }
+
+  void const* const data = _core->getMemoryData(RETRO_MEMORY_SAVE_RAM);
+  size_t const size = _core->getMemorySize(RETRO_MEMORY_SAVE_RAM);
+  uint64_t const hash = hash64(data, size, 0);
+
+  if (hash != _savedHash)
+  {
+    std::string error;
+
+    if (replaceFile(_path, data, size, &error))
+    {
+      _savedHash = hash;
+      _logger->printf(RETRO_LOG_INFO, "Wrote the save RAM to %s", _path.c_str());
+    }
+    else
+    {
+      _logger->printf(RETRO_LOG_ERROR, "%s", error.c_str());
+    }
+  }
+}
+
+void Sram::update()
+{
+  Result result;
+
+  while (_results.pop(&result))
+  {
+    finish(result);
+  }
+
+  if (_path.empty() || _writing)
+  {
+    return;
+  }
+
+  Clock::time_point const now = Clock::now();
+
+  if (now - _checked < std::chrono::seconds(kIntervalSeconds))
+  {
+    return;
+  }
+
+  _checked = now;
+
+  uint8_t const* const data = static_cast<uint8_t const*>(_core->getMemoryData(RETRO_MEMORY_SAVE_RAM));
+  size_t const size = _core->getMemorySize(RETRO_MEMORY_SAVE_RAM);
+  uint64_t const hash = hash64(data, size, 0);
+
+  if (hash == _savedHash)
+  {
+    return;
+  }
+
+  // A copy, the core keeps writing to the save RAM while it's written
+  _copy.assign(data, data + size);
+  _writtenHash = hash;
+  _writing = true;
+
+  {
+    std::lock_guard<std::mutex> lock(_signal);
+    _jobs.push(_path);
+  }
+
+  _wake.notify_one();
+}
+
+void Sram::run()
+{
+  for (;;)
+  {
+    std::string path;
+
+    {
+      std::unique_lock<std::mutex> lock(_signal);
+      _wake.wait(lock, [this]() -> bool { return _quit || _jobs.size() != 0; });
+
+      if (!_jobs.pop(&path))
+      {
+        return;
+      }
+    }
+
+    Result result;
+    result.ok = replaceFile(path, _copy.data(), _copy.size(), &result.message);
+
+    {
+      std::lock_guard<std::mutex> lock(_signal);
+
+      // There's always room, there's only one write at a time
+      _results.push(result);
+    }
+
+    _done.notify_one();
+  }
+}
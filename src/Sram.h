@@ -0,0 +1,79 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include "SpscQueue.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Sram keeps the battery backed save RAM of the game in a file in the save
+ * directory. The file is loaded with the game, and the save RAM is hashed
+ * every few seconds on the emulation thread; when it changed, a copy is
+ * written by an I/O thread, replacing the file only once the copy is on the
+ * disk. Unloading the game writes any change right away.
+ */
+class Sram
+{
+public:
+  bool init(libretro::LoggerComponent* logger, libretro::ConfigComponent* config, libretro::CoreManager* core);
+  void destroy();
+
+  // Writes the save RAM if it changed, must be called while the game is
+  // still loaded.
+  void reset();
+
+  // Loads the save RAM of the game that was just loaded.
+  void setContent(std::string const& gamePath);
+
+  // Must be called on the emulation thread between frames, never waits for
+  // the disk.
+  void update();
+
+protected:
+  typedef std::chrono::steady_clock Clock;
+
+  enum
+  {
+    kIntervalSeconds = 3
+  };
+
+  struct Result
+  {
+    bool        ok;
+    std::string message;
+  };
+
+  void finish(Result const& result);
+  void flush();
+  void run();
+
+  libretro::LoggerComponent* _logger;
+  libretro::ConfigComponent* _config;
+  libretro::CoreManager*     _core;
+
+  std::string       _path;
+  uint64_t          _savedHash;
+  uint64_t          _writtenHash;
+  Clock::time_point _checked;
+  bool              _writing;
+
+  // Owned by the I/O thread while a write is queued
+  std::vector<uint8_t> _copy;
+
+  // Pushing to the queues and setting _quit hold _signal, so that waiting
+  // on the condition variables can't miss them
+  SpscQueue<std::string, 2> _jobs;
+  SpscQueue<Result, 2>      _results;
+  std::mutex                _signal;
+  std::condition_variable   _wake;
+  std::condition_variable   _done;
+  bool                      _quit;
+  std::thread               _worker;
+};
@@ -0,0 +1,154 @@
+#include "TextSearch.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Returns true if the k characters at data have the given k - 1 differences.
+static inline bool matchDeltas(uint8_t const* const data, uint8_t const* const deltas, size_t const count) {
+  for (size_t i = 0; i < count; i++) {
+    if (static_cast<uint8_t>(data[i + 1] - data[i]) != deltas[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void findExact(uint32_t const address,
+                      uint8_t const* const data,
+                      size_t const size,
+                      uint8_t const* const needle,
+                      size_t const length,
+                      std::vector<uint32_t>* const result) {
+
+  if (length == 0 || size < length) {
+    return;
+  }
+
+  size_t const last = size - length + 1;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  // Compare the first and the last bytes of the needle at 16 positions at
+  // once, and only verify the positions where both match.
+  __m128i const first = _mm_set1_epi8(static_cast<char>(needle[0]));
+  __m128i const final = _mm_set1_epi8(static_cast<char>(needle[length - 1]));
+
+  for (; i + 16 <= last; i += 16) {
+    __m128i const block1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i const block2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + length - 1));
+    __m128i const equal = _mm_and_si128(_mm_cmpeq_epi8(first, block1), _mm_cmpeq_epi8(final, block2));
+
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(equal));
+
+    while (mask != 0) {
+      size_t const pos = i + __builtin_ctz(mask);
+
+      if (memcmp(data + pos, needle, length) == 0) {
+        result->emplace_back(address + pos);
+      }
+
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for (; i < last; i++) {
+    if (data[i] == needle[0] && memcmp(data + i, needle, length) == 0) {
+      result->emplace_back(address + i);
+    }
+  }
+}
+
+static void findRelative(uint32_t const address,
+                         uint8_t const* const data,
+                         size_t const size,
+                         uint8_t const* const deltas,
+                         size_t const count,
+                         std::vector<uint32_t>* const result) {
+
+  size_t const length = count + 1;
+
+  if (count == 0 || size < length) {
+    return;
+  }
+
+  size_t const last = size - length + 1;
+  size_t i = 0;
+
+#ifdef __SSE2__
+  // Same as findExact, but the filter looks at the first and last differences.
+  __m128i const first = _mm_set1_epi8(static_cast<char>(deltas[0]));
+  __m128i const final = _mm_set1_epi8(static_cast<char>(deltas[count - 1]));
+
+  for (; i + 16 <= last; i += 16) {
+    __m128i const a0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    __m128i const a1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + 1));
+    __m128i const b0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + count - 1));
+    __m128i const b1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i + count));
+
+    __m128i const equal = _mm_and_si128(_mm_cmpeq_epi8(first, _mm_sub_epi8(a1, a0)),
+                                        _mm_cmpeq_epi8(final, _mm_sub_epi8(b1, b0)));
+
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(equal));
+
+    while (mask != 0) {
+      size_t const pos = i + __builtin_ctz(mask);
+
+      if (matchDeltas(data + pos, deltas, count)) {
+        result->emplace_back(address + pos);
+      }
+
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for (; i < last; i++) {
+    if (matchDeltas(data + i, deltas, count)) {
+      result->emplace_back(address + i);
+    }
+  }
+}
+
+TextSearch::TextSearch(std::vector<uint8_t> const& needle, Mode const mode) : _mode(mode) {
+  if (mode == Mode::Relative) {
+    for (size_t i = 1; i < needle.size(); i++) {
+      _needle.emplace_back(static_cast<uint8_t>(needle[i] - needle[i - 1]));
+    }
+  }
+  else {
+    _needle = needle;
+  }
+}
+
+Set TextSearch::find(Snapshot const& snapshot) const {
+  std::vector<uint32_t> result;
+  find(snapshot, &result);
+  return Set(std::move(result));
+}
+
+Set TextSearch::find(std::vector<Snapshot> const& snapshots) const {
+  std::vector<uint32_t> result;
+
+  for (auto const& snapshot : snapshots) {
+    find(snapshot, &result);
+  }
+
+  return Set(std::move(result));
+}
+
+void TextSearch::find(Snapshot const& snapshot, std::vector<uint32_t>* const result) const {
+  switch (_mode) {
+    case Mode::Exact:
+      findExact(snapshot.address(), snapshot.data(), snapshot.size(), _needle.data(), _needle.size(), result);
+      break;
+
+    case Mode::Relative:
+      findRelative(snapshot.address(), snapshot.data(), snapshot.size(), _needle.data(), _needle.size(), result);
+      break;
+  }
+}
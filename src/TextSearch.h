@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * TextSearch finds strings in snapshots. Exact searches look for the bytes
+ * of a string encoded with a CharTable. Relative searches look for the
+ * differences between successive characters, for when the table is unknown.
+ */
+class TextSearch
+{
+public:
+  enum class Mode
+  {
+    Exact,
+    Relative
+  };
+
+  TextSearch(std::vector<uint8_t> const& needle, Mode const mode);
+
+  Set find(Snapshot const& snapshot) const;
+  Set find(std::vector<Snapshot> const& snapshots) const;
+
+protected:
+  void find(Snapshot const& snapshot, std::vector<uint32_t>* const result) const;
+
+  std::vector<uint8_t> _needle;
+  Mode                 _mode;
+};
@@ -0,0 +1,857 @@
+#include "TimeSeries.h"
+#include "Value.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint32_t const kBlockFrames = 128;
+static size_t const kStagingSize = 32 << 20;
+static size_t const kTileColumns = 1024;
+static size_t const kSliceColumns = 4096;
+static size_t const kEntrySize = 24;
+static uint32_t const kNoPiece = ~0U;
+static uint32_t const kVersion = 2;
+
+namespace {
+  struct Header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t frames;
+    uint32_t columns;
+  };
+
+  struct Segment {
+    unsigned       width;
+    uint8_t        value;
+    uint32_t       frames;
+    uint8_t const* deltas;
+  };
+}
+
+static size_t packedSize(unsigned const width, uint32_t const frames) {
+  return ((frames - 1) * width + 7) / 8;
+}
+
+static void encodeRun(std::vector<uint8_t>* const out, uint8_t const value, uint32_t frames) {
+  out->push_back(0);
+  out->push_back(value);
+
+  while (frames >= 0x80) {
+    out->push_back((frames & 0x7f) | 0x80);
+    frames >>= 7;
+  }
+
+  out->push_back(frames);
+}
+
+static void encodeBlock(std::vector<uint8_t>* const out, uint8_t const* const values, uint32_t const frames) {
+  uint8_t deltas[kBlockFrames];
+  uint8_t all = 0;
+
+  for (uint32_t i = 1; i < frames; i++) {
+    uint8_t const delta = values[i] - values[i - 1];
+    deltas[i] = (delta << 1) ^ ((delta & 0x80) != 0 ? 0xff : 0x00);
+    all |= deltas[i];
+  }
+
+  unsigned width = 0;
+
+  while (all >> width != 0) {
+    width++;
+  }
+
+  if (width == 0) {
+    encodeRun(out, values[0], frames);
+    return;
+  }
+
+  size_t const size = out->size();
+  out->resize(size + 3 + packedSize(width, frames));
+
+  uint8_t* p = out->data() + size;
+  *p++ = width;
+  *p++ = frames;
+  *p++ = values[0];
+
+  uint32_t acc = 0;
+  unsigned bits = 0;
+
+  for (uint32_t i = 1; i < frames; i++) {
+    acc |= static_cast<uint32_t>(deltas[i]) << bits;
+    bits += width;
+
+    if (bits >= 8) {
+      *p++ = acc;
+      acc >>= 8;
+      bits -= 8;
+    }
+  }
+
+  if (bits != 0) {
+    *p = acc;
+  }
+}
+
+// Returns the first byte after the segment, or nullptr if it's malformed.
+static uint8_t const* parseSegment(uint8_t const* p, uint8_t const* const end, Segment* const segment) {
+  if (p == end) {
+    return nullptr;
+  }
+
+  segment->width = *p++;
+
+  if (segment->width == 0) {
+    if (p == end) {
+      return nullptr;
+    }
+
+    segment->value = *p++;
+    segment->frames = 0;
+    segment->deltas = nullptr;
+
+    for (unsigned shift = 0;; shift += 7) {
+      if (p == end || shift > 28) {
+        return nullptr;
+      }
+
+      segment->frames |= static_cast<uint32_t>(*p & 0x7f) << shift;
+
+      if ((*p++ & 0x80) == 0) {
+        break;
+      }
+    }
+
+    return segment->frames != 0 ? p : nullptr;
+  }
+
+  if (segment->width > 8 || end - p < 2) {
+    return nullptr;
+  }
+
+  segment->frames = *p++;
+  segment->value = *p++;
+  segment->deltas = p;
+
+  if (segment->frames == 0 || segment->frames > kBlockFrames) {
+    return nullptr;
+  }
+
+  size_t const size = packedSize(segment->width, segment->frames);
+  return static_cast<size_t>(end - p) >= size ? p + size : nullptr;
+}
+
+// Writes the first count values of the segment.
+static void unpack(Segment const& segment, uint8_t* const values, uint32_t const count) {
+  uint8_t value = segment.value;
+
+  if (segment.width == 0) {
+    memset(values, value, count);
+    return;
+  }
+
+  unsigned const width = segment.width;
+  uint32_t const mask = (1 << width) - 1;
+  uint8_t const* p = segment.deltas;
+  uint32_t acc = 0;
+  unsigned bits = 0;
+
+  values[0] = value;
+
+  for (uint32_t i = 1; i < count; i++) {
+    if (bits < width) {
+      acc |= static_cast<uint32_t>(*p++) << bits;
+      bits += 8;
+    }
+
+    uint32_t const zigzag = acc & mask;
+    acc >>= width;
+    bits -= width;
+
+    value += (zigzag >> 1) ^ -(zigzag & 1);
+    values[i] = value;
+  }
+}
+
+void TimeSeriesRecorder::addSource(uint32_t const address, void const* const data, size_t const size) {
+  Source source;
+  source.address = address;
+  source.data = static_cast<uint8_t const*>(data);
+  source.size = size;
+
+  _sources.emplace_back(source);
+}
+
+void TimeSeriesRecorder::reset() {
+  _sources.clear();
+  _addresses.clear();
+  _encoded.clear();
+  _pieces.clear();
+  _first.clear();
+  _last.clear();
+  _runs.clear();
+  _runValues.clear();
+  _min.clear();
+  _max.clear();
+  _changed.clear();
+  _indices.clear();
+  _rows.clear();
+  _tile.clear();
+  _frames = 0;
+  _pending = 0;
+  _blockFrames = 0;
+}
+
+void TimeSeriesRecorder::capture() {
+  if (_frames == 0) {
+    std::stable_sort(_sources.begin(), _sources.end(), [](Source const& a, Source const& b) -> bool {
+      return a.address < b.address;
+    });
+
+    _addresses.clear();
+
+    for (auto const& source : _sources) {
+      for (size_t i = 0; i < source.size; i++) {
+        _addresses.emplace_back(source.address + i);
+      }
+    }
+
+    size_t const count = _addresses.size();
+    _blockFrames = static_cast<uint32_t>(std::max<size_t>(1, std::min<size_t>(kBlockFrames, kStagingSize / std::max<size_t>(count, 1))));
+
+    _encoded.clear();
+    _pieces.clear();
+    _first.assign(count, kNoPiece);
+    _last.assign(count, kNoPiece);
+    _runs.assign(count, 0);
+    _runValues.assign(count, 0);
+    _min.assign(count, 255);
+    _max.assign(count, 0);
+    _changed.resize(count);
+    _rows.resize(count * _blockFrames);
+    _tile.resize(kTileColumns * kBlockFrames);
+  }
+
+  uint8_t* row = _rows.data() + _pending * _addresses.size();
+
+  for (auto const& source : _sources) {
+    if (source.size != 0) {
+      memcpy(row, source.data, source.size);
+      row += source.size;
+    }
+  }
+
+  _frames++;
+
+  if (++_pending == _blockFrames) {
+    flush();
+  }
+}
+
+void TimeSeriesRecorder::flush() {
+  size_t const count = _addresses.size();
+  uint8_t const* const first = _rows.data();
+  uint8_t* const changed = _changed.data();
+
+  // Find the columns that changed in the pending frames, a slice of
+  // columns at a time so that the slices of the first row and of the
+  // result stay in the cache
+  memset(changed, 0, count);
+
+  for (size_t base = 0; base < count; base += kSliceColumns) {
+    size_t const width = std::min(kSliceColumns, count - base);
+
+    for (uint32_t frame = 1; frame < _pending; frame++) {
+      uint8_t const* const row = first + frame * count + base;
+      size_t i = 0;
+
+#ifdef __SSE2__
+      for (; i + 16 <= width; i += 16) {
+        __m128i const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + i));
+        __m128i const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first + base + i));
+        __m128i const c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(changed + base + i));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(changed + base + i), _mm_or_si128(c, _mm_xor_si128(a, b)));
+      }
+#endif
+
+      for (; i < width; i++) {
+        changed[base + i] |= row[i] ^ first[base + i];
+      }
+    }
+  }
+
+  // Most columns don't change, just extend their runs without touching
+  // the encoded data
+  _indices.clear();
+
+  for (size_t i = 0; i < count; i++) {
+    if (changed[i] != 0) {
+      _indices.emplace_back(i);
+      continue;
+    }
+
+    if (_runs[i] != 0 && _runValues[i] == first[i]) {
+      _runs[i] += _pending;
+    }
+    else {
+      closeRun(i);
+      _runs[i] = _pending;
+      _runValues[i] = first[i];
+    }
+
+    _min[i] = std::min(_min[i], first[i]);
+    _max[i] = std::max(_max[i], first[i]);
+  }
+
+  // Transpose the columns that changed a tile at a time, and append each
+  // column's segment to the encoded data as soon as its tile is done
+  uint8_t* const tile = _tile.data();
+
+  for (size_t base = 0; base < _indices.size(); base += kTileColumns) {
+    size_t const width = std::min(kTileColumns, _indices.size() - base);
+    uint32_t const* const columns = _indices.data() + base;
+
+    for (uint32_t frame = 0; frame < _pending; frame++) {
+      uint8_t const* const row = first + frame * count;
+
+      for (size_t i = 0; i < width; i++) {
+        tile[i * kBlockFrames + frame] = row[columns[i]];
+      }
+    }
+
+    for (size_t i = 0; i < width; i++) {
+      size_t const column = columns[i];
+      uint8_t const* const values = tile + i * kBlockFrames;
+      size_t const offset = _encoded.size();
+
+      if (_runs[column] != 0) {
+        encodeRun(&_encoded, _runValues[column], _runs[column]);
+        _runs[column] = 0;
+      }
+
+      encodeBlock(&_encoded, values, _pending);
+      link(column, offset);
+
+      auto const range = std::minmax_element(values, values + _pending);
+      _min[column] = std::min(_min[column], *range.first);
+      _max[column] = std::max(_max[column], *range.second);
+    }
+  }
+
+  _pending = 0;
+}
+
+void TimeSeriesRecorder::closeRun(size_t const column) {
+  if (_runs[column] != 0) {
+    size_t const offset = _encoded.size();
+
+    encodeRun(&_encoded, _runValues[column], _runs[column]);
+    link(column, offset);
+    _runs[column] = 0;
+  }
+}
+
+void TimeSeriesRecorder::link(size_t const column, size_t const offset) {
+  uint32_t const size = static_cast<uint32_t>(_encoded.size() - offset);
+  uint32_t const last = _last[column];
+
+  if (last != kNoPiece && _pieces[last].offset + _pieces[last].size == offset) {
+    // Nothing else was written since the column's last piece
+    _pieces[last].size += size;
+    return;
+  }
+
+  uint32_t const index = static_cast<uint32_t>(_pieces.size());
+  _pieces.push_back(Piece{offset, size, kNoPiece});
+
+  if (last != kNoPiece) {
+    _pieces[last].next = index;
+  }
+  else {
+    _first[column] = index;
+  }
+
+  _last[column] = index;
+}
+
+bool TimeSeriesRecorder::save(std::string const& path, std::string* const error) {
+  if (_pending != 0) {
+    flush();
+  }
+
+  FILE* const file = fopen(path.c_str(), "wb");
+
+  if (file == NULL) {
+    if (error != nullptr) {
+      *error = strerror(errno);
+    }
+
+    return false;
+  }
+
+  size_t const count = _addresses.size();
+
+  Header header;
+  memcpy(header.magic, "CHTS", 4);
+  header.version = kVersion;
+  header.frames = _frames;
+  header.columns = count;
+
+  uint64_t offset = sizeof(header) + count * kEntrySize;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  // Open runs are written at the end of their columns but kept open, so
+  // that recording can continue after saving
+  std::vector<uint8_t> run;
+
+  for (size_t i = 0; ok && i < count; i++) {
+    run.clear();
+
+    if (_runs[i] != 0) {
+      encodeRun(&run, _runValues[i], _runs[i]);
+    }
+
+    uint32_t const address = _addresses[i];
+    uint32_t size = run.size();
+
+    for (uint32_t piece = _first[i]; piece != kNoPiece; piece = _pieces[piece].next) {
+      size += _pieces[piece].size;
+    }
+
+    uint8_t const range[8] = {_min[i], _max[i]};
+
+    ok = fwrite(&address, sizeof(address), 1, file) == 1 &&
+         fwrite(&size, sizeof(size), 1, file) == 1 &&
+         fwrite(&offset, sizeof(offset), 1, file) == 1 &&
+         fwrite(range, sizeof(range), 1, file) == 1;
+
+    offset += size;
+  }
+
+  for (size_t i = 0; ok && i < count; i++) {
+    for (uint32_t piece = _first[i]; ok && piece != kNoPiece; piece = _pieces[piece].next) {
+      Piece const& p = _pieces[piece];
+      ok = fwrite(_encoded.data() + p.offset, 1, p.size, file) == p.size;
+    }
+
+    run.clear();
+
+    if (_runs[i] != 0) {
+      encodeRun(&run, _runValues[i], _runs[i]);
+    }
+
+    ok = ok && fwrite(run.data(), 1, run.size(), file) == run.size();
+  }
+
+  if (!ok) {
+    if (error != nullptr) {
+      *error = strerror(errno);
+    }
+
+    fclose(file);
+    return false;
+  }
+
+  if (fclose(file) != 0) {
+    if (error != nullptr) {
+      *error = strerror(errno);
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+size_t const TimeSeries::kNone;
+
+TimeSeries::TimeSeries()
+  : _data(nullptr)
+  , _size(0)
+  , _mapped(false)
+  , _directory(nullptr)
+  , _frames(0)
+  , _columns(0) {}
+
+TimeSeries::~TimeSeries() {
+  close();
+}
+
+bool TimeSeries::open(std::string const& path, std::string* const error) {
+  close();
+
+#ifndef _WIN32
+  int const fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+
+  if (fd < 0) {
+    goto error;
+  }
+
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    goto error;
+  }
+
+  if (st.st_size != 0) {
+    void* const data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      goto error;
+    }
+
+    _data = static_cast<uint8_t const*>(data);
+    _size = st.st_size;
+    _mapped = true;
+  }
+
+  ::close(fd);
+#else
+  {
+    FILE* const file = fopen(path.c_str(), "rb");
+
+    if (file == NULL) {
+      goto error;
+    }
+
+    uint8_t buffer[65536];
+    size_t numRead;
+
+    while ((numRead = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+      _buffer.insert(_buffer.end(), buffer, buffer + numRead);
+    }
+
+    fclose(file);
+
+    _data = _buffer.data();
+    _size = _buffer.size();
+  }
+#endif
+
+  {
+    Header header;
+
+    if (_size < sizeof(header)) {
+      goto invalid;
+    }
+
+    memcpy(&header, _data, sizeof(header));
+
+    if (memcmp(header.magic, "CHTS", 4) != 0 || header.version != kVersion) {
+      goto invalid;
+    }
+
+    static_assert(sizeof(Entry) == kEntrySize, "The directory entries must match the file layout");
+
+    if ((_size - sizeof(header)) / sizeof(Entry) < header.columns) {
+      goto invalid;
+    }
+
+    Entry const* const directory = reinterpret_cast<Entry const*>(_data + sizeof(header));
+
+    for (uint32_t i = 0; i < header.columns; i++) {
+      if (directory[i].offset > _size || directory[i].size > _size - directory[i].offset) {
+        goto invalid;
+      }
+    }
+
+    _directory = directory;
+    _frames = header.frames;
+    _columns = header.columns;
+  }
+
+  return true;
+
+error:
+  if (error != nullptr) {
+    *error = strerror(errno);
+  }
+
+  close();
+  return false;
+
+invalid:
+  if (error != nullptr) {
+    *error = "Invalid time series file";
+  }
+
+  close();
+  return false;
+}
+
+void TimeSeries::close() {
+#ifndef _WIN32
+  if (_mapped) {
+    munmap(const_cast<uint8_t*>(_data), _size);
+  }
+#endif
+
+  _buffer.clear();
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+  _directory = nullptr;
+  _frames = 0;
+  _columns = 0;
+}
+
+size_t TimeSeries::find(uint32_t const address) const {
+  Entry const* const end = _directory + _columns;
+
+  Entry const* const found = std::lower_bound(_directory, end, address, [](Entry const& entry, uint32_t const address) -> bool {
+    return entry.address < address;
+  });
+
+  return found != end && found->address == address ? static_cast<size_t>(found - _directory) : kNone;
+}
+
+void TimeSeries::decode(size_t const column, uint8_t* const values) const {
+  Entry const& entry = _directory[column];
+  uint8_t const* p = _data + entry.offset;
+  uint8_t const* const end = p + entry.size;
+  uint32_t frame = 0;
+
+  while (frame < _frames) {
+    Segment segment;
+    p = parseSegment(p, end, &segment);
+
+    if (p == nullptr) {
+      memset(values + frame, 0, _frames - frame);
+      break;
+    }
+
+    uint32_t const count = std::min(segment.frames, _frames - frame);
+    unpack(segment, values + frame, count);
+    frame += count;
+  }
+}
+
+template<Snapshot::Operator O>
+static void select(uint8_t const* const values, size_t const count, uint8_t const value, uint8_t* const mask) {
+  for (size_t i = 0; i < count; i++) {
+    mask[i] = compare<O>(values[i], value);
+  }
+}
+
+std::vector<uint8_t> TimeSeries::where(uint32_t const address, Snapshot::Operator const op, uint8_t const value) const {
+  std::vector<uint8_t> mask(_frames, 0);
+  size_t const column = find(address);
+
+  if (column == kNone) {
+    return mask;
+  }
+
+  std::vector<uint8_t> values(_frames);
+  decode(column, values.data());
+
+  switch (op) {
+    case Snapshot::Operator::LessThan:     select<Snapshot::Operator::LessThan>(values.data(), _frames, value, mask.data()); break;
+    case Snapshot::Operator::LessEqual:    select<Snapshot::Operator::LessEqual>(values.data(), _frames, value, mask.data()); break;
+    case Snapshot::Operator::GreaterThan:  select<Snapshot::Operator::GreaterThan>(values.data(), _frames, value, mask.data()); break;
+    case Snapshot::Operator::GreaterEqual: select<Snapshot::Operator::GreaterEqual>(values.data(), _frames, value, mask.data()); break;
+    case Snapshot::Operator::Equal:        select<Snapshot::Operator::Equal>(values.data(), _frames, value, mask.data()); break;
+    case Snapshot::Operator::NotEqual:     select<Snapshot::Operator::NotEqual>(values.data(), _frames, value, mask.data()); break;
+  }
+
+  return mask;
+}
+
+Set TimeSeries::sequence(uint8_t const* const values, size_t const count, bool const repeats) const {
+  std::vector<uint8_t> pattern(values, values + count);
+
+  if (!repeats) {
+    pattern.erase(std::unique(pattern.begin(), pattern.end()), pattern.end());
+  }
+
+  std::vector<uint32_t> result;
+
+  if (pattern.empty()) {
+    return Set(std::move(result));
+  }
+
+  auto const range = std::minmax_element(pattern.begin(), pattern.end());
+  std::vector<uint8_t> series(_frames);
+
+  for (size_t column = 0; column < _columns; column++) {
+    // Most columns never hold all the values of the pattern
+    if (_directory[column].min > *range.first || _directory[column].max < *range.second) {
+      continue;
+    }
+
+    decode(column, series.data());
+
+    auto end = series.end();
+
+    if (!repeats) {
+      end = std::unique(series.begin(), end);
+    }
+
+    if (std::search(series.begin(), end, pattern.begin(), pattern.end()) != end) {
+      result.emplace_back(_directory[column].address);
+    }
+  }
+
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return Set(std::move(result));
+}
+
+Set TimeSeries::constant(std::vector<uint8_t> const& mask) const {
+  std::vector<uint32_t> result;
+
+  if (mask.size() != _frames) {
+    return Set(std::move(result));
+  }
+
+  // Counts of selected frames, so that segments without any can be skipped
+  std::vector<uint32_t> selected(_frames + 1);
+  selected[0] = 0;
+
+  for (uint32_t frame = 0; frame < _frames; frame++) {
+    selected[frame + 1] = selected[frame] + (mask[frame] != 0);
+  }
+
+  uint8_t values[kBlockFrames];
+
+  for (size_t column = 0; column < _columns; column++) {
+    Entry const& entry = _directory[column];
+    uint8_t const* p = _data + entry.offset;
+    uint8_t const* const end = p + entry.size;
+
+    bool found = false;
+    bool same = true;
+    uint8_t value = 0;
+
+    for (uint32_t frame = 0; same && frame < _frames;) {
+      Segment segment;
+      p = parseSegment(p, end, &segment);
+
+      if (p == nullptr) {
+        same = false;
+        break;
+      }
+
+      uint32_t const count = std::min(segment.frames, _frames - frame);
+
+      if (selected[frame + count] == selected[frame]) {
+        // Nothing to check
+      }
+      else if (segment.width == 0) {
+        same = !found || segment.value == value;
+        value = segment.value;
+        found = true;
+      }
+      else {
+        unpack(segment, values, count);
+
+        for (uint32_t i = 0; i < count; i++) {
+          if (mask[frame + i] != 0) {
+            if (found && values[i] != value) {
+              same = false;
+              break;
+            }
+
+            value = values[i];
+            found = true;
+          }
+        }
+      }
+
+      frame += count;
+    }
+
+    if (found && same) {
+      result.emplace_back(entry.address);
+    }
+  }
+
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return Set(std::move(result));
+}
+
+static bool writeNpyHeader(FILE* const file, char const* const descr, char const* const shape) {
+  char dict[128];
+  int length = snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': %s, }", descr, shape);
+
+  // The preamble is 10 bytes, pad the header with spaces and a new line so
+  // that the data is aligned to 64 bytes
+  size_t const total = (10 + length + 1 + 63) & ~size_t(63);
+  std::string header(dict, length);
+  header.append(total - 10 - length - 1, ' ');
+  header.append(1, '\n');
+
+  uint8_t preamble[10] = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0};
+  preamble[8] = header.size() & 0xff;
+  preamble[9] = header.size() >> 8;
+
+  return fwrite(preamble, 1, sizeof(preamble), file) == sizeof(preamble) &&
+         fwrite(header.c_str(), 1, header.size(), file) == header.size();
+}
+
+bool TimeSeries::exportNpy(std::string const& values, std::string const& addresses, std::string* const error) const {
+  char shape[64];
+  std::vector<uint8_t> series(_frames);
+  bool ok;
+
+  FILE* file = fopen(values.c_str(), "wb");
+
+  if (file == NULL) {
+    goto error;
+  }
+
+  snprintf(shape, sizeof(shape), "(%zu, %u)", _columns, _frames);
+  ok = writeNpyHeader(file, "|u1", shape);
+
+  for (size_t column = 0; ok && column < _columns; column++) {
+    decode(column, series.data());
+    ok = fwrite(series.data(), 1, series.size(), file) == series.size();
+  }
+
+  if (fclose(file) != 0 || !ok) {
+    goto error;
+  }
+
+  file = fopen(addresses.c_str(), "wb");
+
+  if (file == NULL) {
+    goto error;
+  }
+
+  {
+    uint16_t const one = 1;
+    bool const little = *reinterpret_cast<uint8_t const*>(&one) == 1;
+
+    snprintf(shape, sizeof(shape), "(%zu,)", _columns);
+    ok = writeNpyHeader(file, little ? "<u4" : ">u4", shape);
+
+    for (size_t column = 0; ok && column < _columns; column++) {
+      ok = fwrite(&_directory[column].address, sizeof(uint32_t), 1, file) == 1;
+    }
+  }
+
+  if (fclose(file) != 0 || !ok) {
+    goto error;
+  }
+
+  return true;
+
+error:
+  if (error != nullptr) {
+    *error = strerror(errno);
+  }
+
+  return false;
+}
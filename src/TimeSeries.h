@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Set.h"
+#include "Snapshot.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * A columnar store of per-frame memory captures. Each address gets its own
+ * column with the byte values it had in every recorded frame. A column is a
+ * list of segments, either a run of frames where the value didn't change,
+ * or up to 128 frames with the first value followed by the zigzag encoded
+ * deltas packed with the minimum bit width needed by the segment.
+ *
+ * File layout, all integers in host byte order:
+ *
+ *   Header    magic "CHTS", version, frames, columns
+ *   Directory one { address, size, offset, min, max } entry per column,
+ *             sorted by address, where min and max are the smallest and
+ *             largest values in the column
+ *   Data      the segments of each column, one column after the other
+ *
+ * Segments start with a byte with the bit width. A width of zero is a run
+ * followed by the value and the number of frames as a varint, otherwise the
+ * width is followed by the number of frames, the first value, and the
+ * packed deltas.
+ *
+ * The recorder keeps the frames of the current block, and appends the
+ * segments of each block to one buffer shared by all columns, keeping a
+ * list of pieces per column. Blocks are shorter than 128 frames when the
+ * regions are large, so that the block of frames stays under 32 MiB.
+ */
+class TimeSeriesRecorder
+{
+public:
+  TimeSeriesRecorder() : _frames(0), _pending(0), _blockFrames(0) {}
+
+  // Sources must be added before the first capture.
+  void addSource(uint32_t const address, void const* const data, size_t const size);
+  void reset();
+
+  // Copies the current contents of all sources as a new frame.
+  void capture();
+
+  bool save(std::string const& path, std::string* const error);
+
+  uint32_t frames() const { return _frames; }
+  size_t columns() const { return _addresses.size(); }
+  size_t encodedSize() const { return _encoded.size(); }
+
+protected:
+  struct Source
+  {
+    uint32_t       address;
+    uint8_t const* data;
+    size_t         size;
+  };
+
+  // Bytes of a column in _encoded, the pieces of a column are linked in
+  // the order they were written
+  struct Piece
+  {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t next;
+  };
+
+  void flush();
+  void closeRun(size_t const column);
+  void link(size_t const column, size_t const offset);
+
+  std::vector<Source>   _sources;
+  std::vector<uint32_t> _addresses;
+  std::vector<uint8_t>  _encoded;
+  std::vector<Piece>    _pieces;
+  std::vector<uint32_t> _first;
+  std::vector<uint32_t> _last;
+  std::vector<uint32_t> _runs;
+  std::vector<uint8_t>  _runValues;
+  std::vector<uint8_t>  _min;
+  std::vector<uint8_t>  _max;
+  std::vector<uint8_t>  _changed;
+  std::vector<uint32_t> _indices;
+  std::vector<uint8_t>  _rows;
+  std::vector<uint8_t>  _tile;
+  uint32_t              _frames;
+  uint32_t              _pending;
+  uint32_t              _blockFrames;
+};
+
+class TimeSeries
+{
+public:
+  // The column of an address that isn't recorded.
+  static size_t const kNone = ~static_cast<size_t>(0);
+
+  TimeSeries();
+  ~TimeSeries();
+
+  bool open(std::string const& path, std::string* const error);
+  void close();
+
+  uint32_t frames() const { return _frames; }
+  size_t columns() const { return _columns; }
+  uint32_t address(size_t const column) const { return _directory[column].address; }
+
+  // Returns the column of the address, or kNone.
+  size_t find(uint32_t const address) const;
+
+  // Writes frames() values.
+  void decode(size_t const column, uint8_t* const values) const;
+
+  // Returns one byte per frame, 1 where the value at the address satisfies
+  // the condition.
+  std::vector<uint8_t> where(uint32_t const address, Snapshot::Operator const op, uint8_t const value) const;
+
+  // Addresses whose values contain the sequence at any point. When repeats
+  // is false, runs of the same value count as one, so a countdown that
+  // stays in each value for a few frames still matches 3, 2, 1, 0.
+  Set sequence(uint8_t const* const values, size_t const count, bool const repeats) const;
+
+  // Addresses that have the same value in all frames selected by the mask.
+  Set constant(std::vector<uint8_t> const& mask) const;
+
+  // Exports a (columns, frames) uint8 matrix and the matching uint32
+  // addresses as NumPy .npy files.
+  bool exportNpy(std::string const& values, std::string const& addresses, std::string* const error) const;
+
+protected:
+  struct Entry
+  {
+    uint32_t address;
+    uint32_t size;
+    uint64_t offset;
+    uint8_t  min;
+    uint8_t  max;
+    uint8_t  reserved[6];
+  };
+
+  uint8_t const*       _data;
+  size_t               _size;
+  std::vector<uint8_t> _buffer;
+  bool                 _mapped;
+
+  Entry const* _directory;
+  uint32_t     _frames;
+  size_t       _columns;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+
+/**
+ * Hands the latest item from exactly one writer thread to exactly one reader
+ * thread without either of them ever waiting. The writer fills the back
+ * buffer and publishes it, the reader takes whatever was published last;
+ * items published in between are dropped.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : _buffers(), _back(0), _middle(1), _front(2) {}
+
+  // Writer side.
+  T* back() {
+    return &_buffers[_back];
+  }
+
+  void publish() {
+    _back = _middle.exchange(_back | kFresh, std::memory_order_acq_rel) & kIndex;
+  }
+
+  // Reader side. Returns true if an item was published since the last call,
+  // in which case front() now points to it.
+  bool update() {
+    if ((_middle.load(std::memory_order_relaxed) & kFresh) == 0) {
+      return false;
+    }
+
+    _front = _middle.exchange(_front, std::memory_order_acq_rel) & kIndex;
+    return true;
+  }
+
+  T* front() {
+    return &_buffers[_front];
+  }
+
+protected:
+  enum : unsigned {
+    kIndex = 3,
+    kFresh = 4
+  };
+
+  T _buffers[3];
+
+  // Each index is only touched by its own thread, except for the middle one
+  alignas(64) unsigned _back;
+  alignas(64) std::atomic<unsigned> _middle;
+  alignas(64) unsigned _front;
+};
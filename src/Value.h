@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Snapshot.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers shared by the search engines to read, decode and compare values.
+
+template<Snapshot::Operator O>
+inline bool compare(uint32_t const v1, uint32_t const v2) {
+  switch (O) {
+  case Snapshot::Operator::LessThan:     return v1 < v2;
+  case Snapshot::Operator::LessEqual:    return v1 <= v2;
+  case Snapshot::Operator::GreaterThan:  return v1 > v2;
+  case Snapshot::Operator::GreaterEqual: return v1 >= v2;
+  case Snapshot::Operator::Equal:        return v1 == v2;
+  case Snapshot::Operator::NotEqual:     return v1 != v2;
+  }
+
+  return false;
+}
+
+// v holds S bytes in memory order, the first byte in the lowest 8 bits.
+template<size_t S, Snapshot::Format F>
+inline uint32_t convert(uint32_t v) {
+  switch (F) {
+    case Snapshot::Format::UIntLittleEndian:
+      return v;
+
+    case Snapshot::Format::UIntBigEndian:
+      v = (v >> 24 & UINT32_C(0x000000ff)) |
+          (v >>  8 & UINT32_C(0x0000ff00)) |
+          (v <<  8 & UINT32_C(0x00ff0000)) |
+          (v << 24 & UINT32_C(0xff000000));
+
+      return v >> ((4 - S) * 8);
+
+    case Snapshot::Format::BCDBigEndian:
+      v = convert<S, Snapshot::Format::UIntBigEndian>(v);
+      // fallthrough
+
+    case Snapshot::Format::BCDLittleEndian:
+      return (v >>  0 & 15) * UINT32_C(       1) +
+             (v >>  4 & 15) * UINT32_C(      10) +
+             (v >>  8 & 15) * UINT32_C(     100) +
+             (v >> 12 & 15) * UINT32_C(    1000) +
+             (v >> 16 & 15) * UINT32_C(   10000) +
+             (v >> 20 & 15) * UINT32_C(  100000) +
+             (v >> 24 & 15) * UINT32_C( 1000000) +
+             (v >> 28 & 15) * UINT32_C(10000000);
+  }
+
+  return v;
+}
+
+template<size_t S>
+inline uint32_t read(uint8_t const* const bytes) {
+  uint32_t value = bytes[0];
+
+  if (S >= 2) {
+    value |= static_cast<uint32_t>(bytes[1]) << 8;
+  }
+
+  if (S >= 3) {
+    value |= static_cast<uint32_t>(bytes[2]) << 16;
+  }
+
+  if (S >= 4) {
+    value |= static_cast<uint32_t>(bytes[3]) << 24;
+  }
+
+  return value;
+}
+
+template<size_t S, Snapshot::Format F>
+inline uint32_t read(uint8_t const* const bytes) {
+  return convert<S, F>(read<S>(bytes));
+}
+
+inline size_t sizeOf(Snapshot::Size const bits) {
+  switch (bits) {
+    default: // never happens
+    case Snapshot::Size::_8:  return 1;
+    case Snapshot::Size::_16: return 2;
+    case Snapshot::Size::_24: return 3;
+    case Snapshot::Size::_32: return 4;
+  }
+}
+
+// Runtime versions for code that isn't specialized per operator, size and
+// format.
+
+inline bool compare(Snapshot::Operator const op, uint32_t const v1, uint32_t const v2) {
+  switch (op) {
+    case Snapshot::Operator::LessThan:     return compare<Snapshot::Operator::LessThan>(v1, v2);
+    case Snapshot::Operator::LessEqual:    return compare<Snapshot::Operator::LessEqual>(v1, v2);
+    case Snapshot::Operator::GreaterThan:  return compare<Snapshot::Operator::GreaterThan>(v1, v2);
+    case Snapshot::Operator::GreaterEqual: return compare<Snapshot::Operator::GreaterEqual>(v1, v2);
+    case Snapshot::Operator::Equal:        return compare<Snapshot::Operator::Equal>(v1, v2);
+    case Snapshot::Operator::NotEqual:     return compare<Snapshot::Operator::NotEqual>(v1, v2);
+  }
+
+  return false;
+}
+
+template<size_t S>
+inline uint32_t read(Snapshot::Format const format, uint8_t const* const bytes) {
+  switch (format) {
+    case Snapshot::Format::UIntLittleEndian: return read<S, Snapshot::Format::UIntLittleEndian>(bytes);
+    case Snapshot::Format::UIntBigEndian:    return read<S, Snapshot::Format::UIntBigEndian>(bytes);
+    case Snapshot::Format::BCDLittleEndian:  return read<S, Snapshot::Format::BCDLittleEndian>(bytes);
+    case Snapshot::Format::BCDBigEndian:     return read<S, Snapshot::Format::BCDBigEndian>(bytes);
+  }
+
+  return 0;
+}
+
+inline uint32_t read(Snapshot::Size const bits, Snapshot::Format const format, uint8_t const* const bytes) {
+  switch (bits) {
+    case Snapshot::Size::_8:  return read<1>(format, bytes);
+    case Snapshot::Size::_16: return read<2>(format, bytes);
+    case Snapshot::Size::_24: return read<3>(format, bytes);
+    case Snapshot::Size::_32: return read<4>(format, bytes);
+  }
+
+  return 0;
+}
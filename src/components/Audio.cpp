@@ -265,10 +265,11 @@ void Audio::mix(const int16_t* samples, size_t frames) {
   out_len &= ~1; // don't send incomplete audio frames
   size_t size = out_len * 2;
   
-  while (size > avail) {
-    //_logger->debug(TAG "Requested %zu bytes but only %zu available, sleeping", size, avail);
-    SDL_Delay(1);
-    avail = _fifo->free();
+  if (size > avail) {
+    // The emulation thread does its own pacing, so never wait for the audio
+    // device; drop what doesn't fit, the rate control will catch up
+    //_logger->debug(TAG "Requested %zu bytes but only %zu available, dropping", size, avail);
+    size = avail & ~3;
   }
 
   _fifo->write(output, size);
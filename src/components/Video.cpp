@@ -1,13 +1,23 @@
 #include "Video.h"
+#include "Hash.h"
 
 #include <imgui.h>
 
+#include <algorithm>
+#include <string.h>
+
 bool Video::init(libretro::LoggerComponent* logger)
 {
   _logger = logger;
   _texture = 0;
+  _uploadedWidth = _uploadedHeight = 0;
+  _uploadedFormat = RETRO_PIXEL_FORMAT_UNKNOWN;
+  _textureWidth = _textureHeight = 0;
+  _pixelFormat = RETRO_PIXEL_FORMAT_0RGB1555;
+  _aspect = 1.0f;
   _opened = true;
   _width = _height = 0;
+  setWatch(0, 0, 0, 0);
   return true;
 }
 
@@ -16,6 +26,7 @@ void Video::destroy()
   if (_texture != 0)
   {
     glDeleteTextures(1, &_texture);
+    _texture = 0;
   }
 }
 
@@ -25,65 +36,132 @@ void Video::reset()
 
 void Video::draw()
 {
+  if (_frames.update())
+  {
+    upload(_frames.front());
+  }
+
+  Frame const* frame = _frames.front();
+
   if (_texture != 0)
   {
     ImVec2 min = ImGui::GetWindowContentRegionMin();
     ImVec2 max = ImGui::GetWindowContentRegionMax();
 
     float height = max.y - min.y;
-    float width = height * _aspect;
+    float width = height * frame->aspect;
 
     if (width > max.x - min.x)
     {
       width = max.x - min.x;
-      height = width / _aspect;
+      height = width / frame->aspect;
     }
 
     ImVec2 size = ImVec2(width, height);
     ImVec2 uv0 = ImVec2(0.0f, 0.0f);
 
     ImVec2 uv1 = ImVec2(
-      (float)_width / _textureWidth,
-      (float)_height / _textureHeight
+      (float)frame->width / _uploadedWidth,
+      (float)frame->height / _uploadedHeight
     );
 
     ImGui::Image((ImTextureID)(uintptr_t)_texture, size, uv0, uv1);
   }
 }
 
-bool Video::setGeometry(unsigned width, unsigned height, float aspect, enum retro_pixel_format pixelFormat)
+void Video::upload(Frame const* frame)
 {
-  if (_texture != 0)
+  if (frame->width == 0 || frame->height == 0)
   {
-    glDeleteTextures(1, &_texture);
+    return;
   }
 
   GLint previous_texture;
   glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous_texture);
-  
-  glGenTextures(1, &_texture);
-  glBindTexture(GL_TEXTURE_2D, _texture);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  
-  switch (pixelFormat)
+
+  if (_texture == 0 || frame->textureWidth != _uploadedWidth || frame->textureHeight != _uploadedHeight || frame->pixelFormat != _uploadedFormat)
+  {
+    if (_texture != 0)
+    {
+      glDeleteTextures(1, &_texture);
+    }
+
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    switch (frame->pixelFormat)
+    {
+    case RETRO_PIXEL_FORMAT_XRGB8888:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame->textureWidth, frame->textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      break;
+
+    case RETRO_PIXEL_FORMAT_RGB565:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame->textureWidth, frame->textureHeight, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
+      break;
+
+    case RETRO_PIXEL_FORMAT_0RGB1555:
+    default:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame->textureWidth, frame->textureHeight, 0, GL_RGB, GL_UNSIGNED_SHORT_1_5_5_5_REV, NULL);
+      break;
+    }
+
+    _uploadedWidth = frame->textureWidth;
+    _uploadedHeight = frame->textureHeight;
+    _uploadedFormat = frame->pixelFormat;
+  }
+  else
+  {
+    glBindTexture(GL_TEXTURE_2D, _texture);
+  }
+
+  // The rows are packed, so the whole frame goes in one call
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  switch (frame->pixelFormat)
   {
   case RETRO_PIXEL_FORMAT_XRGB8888:
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    {
+      size_t count = (size_t)frame->width * frame->height;
+      _converted.resize(count);
+
+      const uint32_t* s = (const uint32_t*)frame->pixels.data();
+      uint32_t* r = _converted.data();
+
+      for (size_t i = 0; i < count; i++)
+      {
+        uint32_t color = *s++;
+        uint32_t red   = (color >> 16) & 255;
+        uint32_t green = (color >> 8) & 255;
+        uint32_t blue  = color & 255;
+        *r++ = 0xff000000UL | blue << 16 | green << 8 | red;
+      }
+
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame->width, frame->height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)_converted.data());
+    }
+
     break;
-    
+
   case RETRO_PIXEL_FORMAT_RGB565:
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, NULL);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame->width, frame->height, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, (void*)frame->pixels.data());
     break;
-    
+
   case RETRO_PIXEL_FORMAT_0RGB1555:
   default:
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_SHORT_1_5_5_5_REV, NULL);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame->width, frame->height, GL_RGB, GL_UNSIGNED_SHORT_1_5_5_5_REV, (void*)frame->pixels.data());
     break;
   }
 
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   glBindTexture(GL_TEXTURE_2D, previous_texture);
+}
+
+bool Video::setGeometry(unsigned width, unsigned height, float aspect, enum retro_pixel_format pixelFormat)
+{
+  // The texture is recreated on the UI thread when it sees a frame with the
+  // new geometry
   _textureWidth = width;
   _textureHeight = height;
   _pixelFormat = pixelFormat;
@@ -98,62 +176,35 @@ void Video::refresh(const void* data, unsigned width, unsigned height, size_t pi
 {
   if (data != NULL && data != RETRO_HW_FRAME_BUFFER_VALID)
   {
-    GLint previous_texture;
-    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous_texture);
-    
-    glBindTexture(GL_TEXTURE_2D, _texture);
-    uint8_t* p = (uint8_t*)data;
+    hashWatch(data, width, height, pitch);
 
-    GLenum type;
-    
-    switch (_pixelFormat)
-    {
-    case RETRO_PIXEL_FORMAT_XRGB8888:
-      {
-        uint32_t* q = (uint32_t*)alloca(width * 4);
-
-        if (q != NULL)
-        {
-          for (unsigned y = 0; y < height; y++)
-          {
-            uint32_t* r = q;
-            uint32_t* s = (uint32_t*)p;
-
-            for (unsigned x = 0; x < width; x++)
-            {
-              uint32_t color = *s++;
-              uint32_t red   = (color >> 16) & 255;
-              uint32_t green = (color >> 8) & 255;
-              uint32_t blue  = color & 255;
-              *r++ = 0xff000000UL | blue << 16 | green << 8 | red;
-            }
-
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void*)q);
-            p += pitch;
-          }
-        }
-      }
-      
-      goto end;
-      
-    case RETRO_PIXEL_FORMAT_RGB565:
-      type = GL_UNSIGNED_SHORT_5_6_5;
-      break;
-      
-    case RETRO_PIXEL_FORMAT_0RGB1555:
-    default:
-      type = GL_UNSIGNED_SHORT_1_5_5_5_REV;
-      break;
-    }
+    // Cores may refresh with a bigger frame than the geometry they set
+    width = std::min(width, _textureWidth);
+    height = std::min(height, _textureHeight);
+
+    Frame* frame = _frames.back();
+    size_t bpp = _pixelFormat == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+    size_t row = width * bpp;
+
+    frame->pixels.resize(row * height);
+    frame->width = width;
+    frame->height = height;
+    frame->textureWidth = _textureWidth;
+    frame->textureHeight = _textureHeight;
+    frame->pixelFormat = _pixelFormat;
+    frame->aspect = _aspect;
+
+    const uint8_t* p = (const uint8_t*)data;
+    uint8_t* q = frame->pixels.data();
 
     for (unsigned y = 0; y < height; y++)
     {
-      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, 1, GL_RGB, type, (void*)p);
+      memcpy(q, p, row);
       p += pitch;
+      q += row;
     }
 
-  end:
-    glBindTexture(GL_TEXTURE_2D, previous_texture);
+    _frames.publish();
 
     if (width != _width || height != _height)
     {
@@ -165,6 +216,47 @@ void Video::refresh(const void* data, unsigned width, unsigned height, size_t pi
   }
 }
 
+void Video::setWatch(unsigned x, unsigned y, unsigned width, unsigned height)
+{
+  _watchX = x;
+  _watchY = y;
+  _watchWidth = width;
+  _watchHeight = height;
+  _watchHash = 0;
+  _watchChanged = false;
+}
+
+bool Video::watchChanged()
+{
+  bool changed = _watchChanged;
+  _watchChanged = false;
+  return changed;
+}
+
+void Video::hashWatch(const void* data, unsigned width, unsigned height, size_t pitch)
+{
+  if (_watchX >= width || _watchY >= height || _watchWidth == 0 || _watchHeight == 0)
+  {
+    return;
+  }
+
+  unsigned bpp = _pixelFormat == RETRO_PIXEL_FORMAT_XRGB8888 ? 4 : 2;
+  unsigned w = std::min(_watchWidth, width - _watchX);
+  unsigned h = std::min(_watchHeight, height - _watchY);
+
+  const uint8_t* row = (const uint8_t*)data + _watchY * pitch + _watchX * bpp;
+  uint64_t hash = 0;
+
+  for (unsigned y = 0; y < h; y++)
+  {
+    hash = hash64(row, w * bpp, hash);
+    row += pitch;
+  }
+
+  _watchChanged = _watchChanged || hash != _watchHash;
+  _watchHash = hash;
+}
+
 uintptr_t Video::getCurrentFramebuffer()
 {
   return 0;
@@ -1,10 +1,19 @@
 #pragma once
 
 #include "libretro/Components.h"
+#include "TripleBuffer.h"
 
 #include <SDL.h>
 #include <SDL_opengl.h>
 
+#include <stdint.h>
+#include <vector>
+
+/**
+ * refresh and setGeometry run on the emulation thread, which only copies the
+ * frame and hands it over; draw runs on the UI thread, which owns the texture
+ * and uploads the latest frame it got.
+ */
 class Video: public libretro::VideoComponent
 {
 public:
@@ -13,6 +22,10 @@ public:
   void reset();
   void draw();
 
+  // Hashes a rectangle of every frame to tell when its contents change.
+  void setWatch(unsigned x, unsigned y, unsigned width, unsigned height);
+  bool watchChanged();
+
   virtual bool setGeometry(unsigned width, unsigned height, float aspect, enum retro_pixel_format pixelFormat) override;
   virtual void refresh(const void* data, unsigned width, unsigned height, size_t pitch) override;
 
@@ -21,14 +34,46 @@ public:
   virtual void showMessage(std::string const& msg, unsigned frames) override;
 
 protected:
+  struct Frame
+  {
+    // Rows are packed, without the pitch padding.
+    std::vector<uint8_t>    pixels;
+    unsigned                width;
+    unsigned                height;
+    unsigned                textureWidth;
+    unsigned                textureHeight;
+    enum retro_pixel_format pixelFormat;
+    float                   aspect;
+  };
+
+  void hashWatch(const void* data, unsigned width, unsigned height, size_t pitch);
+  void upload(Frame const* frame);
+
   libretro::LoggerComponent* _logger;
-  GLuint                  _texture;
+
+  // Emulation thread
   unsigned                _textureWidth;
   unsigned                _textureHeight;
   enum retro_pixel_format _pixelFormat;
+  float                   _aspect;
+  unsigned                _width;
+  unsigned                _height;
+
+  TripleBuffer<Frame> _frames;
+
+  // UI thread
+  GLuint                  _texture;
+  unsigned                _uploadedWidth;
+  unsigned                _uploadedHeight;
+  enum retro_pixel_format _uploadedFormat;
+  std::vector<uint32_t>   _converted;
+
+  bool _opened;
 
-  bool     _opened;
-  unsigned _width;
-  unsigned _height;
-  float    _aspect;
+  unsigned _watchX;
+  unsigned _watchY;
+  unsigned _watchWidth;
+  unsigned _watchHeight;
+  uint64_t _watchHash;
+  bool     _watchChanged;
 };
@@ -0,0 +1,384 @@
+#include "Components.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool headless::Logger::init(enum retro_log_level const level)
+{
+  _level = level;
+  return true;
+}
+
+void headless::Logger::vprintf(enum retro_log_level level, const char* fmt, va_list args)
+{
+  if (level < _level)
+  {
+    return;
+  }
+
+  static char const* const prefixes[] = {"[DEBUG] ", "[INFO ] ", "[WARN ] ", "[ERROR] "};
+
+  fputs(prefixes[level <= RETRO_LOG_ERROR ? level : RETRO_LOG_ERROR], stderr);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+}
+
+bool headless::Config::init(libretro::LoggerComponent* logger, std::string const& directory)
+{
+  _logger = logger;
+  _directory = directory;
+  _updated = false;
+  return true;
+}
+
+void headless::Config::setOption(std::string const& key, std::string const& value)
+{
+  _options[key] = value;
+
+  auto const it = _values.find(key);
+
+  if (it != _values.end() && it->second != value)
+  {
+    it->second = value;
+    _updated = true;
+  }
+}
+
+std::string const& headless::Config::getCoreAssetsDirectory()
+{
+  return _directory;
+}
+
+std::string const& headless::Config::getSaveDirectory()
+{
+  return _directory;
+}
+
+std::string const& headless::Config::getSystemPath()
+{
+  return _directory;
+}
+
+void headless::Config::setVariables(std::vector<libretro::Variable> const& variables)
+{
+  _values.clear();
+
+  for (auto const& element : variables)
+  {
+    // The value is "Description; default|other|..."
+    size_t aux = element.value.find(';');
+    std::string value;
+
+    if (aux != std::string::npos)
+    {
+      aux++;
+
+      while (aux < element.value.length() && isspace(element.value[aux]))
+      {
+        aux++;
+      }
+
+      value = element.value.substr(aux, element.value.find('|', aux) - aux);
+    }
+
+    auto const option = _options.find(element.key);
+
+    if (option != _options.end())
+    {
+      value = option->second;
+      _updated = true;
+    }
+
+    _values[element.key] = value;
+  }
+}
+
+bool headless::Config::varUpdated()
+{
+  bool updated = _updated;
+  _updated = false;
+  return updated;
+}
+
+std::string const& headless::Config::getVariable(std::string const& variable)
+{
+  static std::string const empty = "";
+
+  auto const it = _values.find(variable);
+
+  if (it != _values.end())
+  {
+    return it->second;
+  }
+
+  _logger->printf(RETRO_LOG_ERROR, "Unknown variable %s", variable.c_str());
+  return empty;
+}
+
+bool headless::Video::init(libretro::LoggerComponent* logger)
+{
+  _logger = logger;
+  return true;
+}
+
+bool headless::Video::setGeometry(unsigned width, unsigned height, float aspect, enum retro_pixel_format pixelFormat)
+{
+  (void)pixelFormat;
+  _logger->printf(RETRO_LOG_DEBUG, "Geometry set to %u x %u (1:%f)", width, height, aspect);
+  return true;
+}
+
+void headless::Video::refresh(const void* data, unsigned width, unsigned height, size_t pitch)
+{
+  (void)data;
+  (void)width;
+  (void)height;
+  (void)pitch;
+}
+
+uintptr_t headless::Video::getCurrentFramebuffer()
+{
+  return 0;
+}
+
+void headless::Video::showMessage(std::string const& msg, unsigned frames)
+{
+  _logger->printf(RETRO_LOG_INFO, "OSD message (%u): %s", frames, msg.c_str());
+}
+
+bool headless::Audio::setRate(double rate)
+{
+  (void)rate;
+  return true;
+}
+
+void headless::Audio::mix(const int16_t* samples, size_t frames)
+{
+  (void)samples;
+  (void)frames;
+}
+
+bool headless::Input::init(libretro::LoggerComponent* logger)
+{
+  _logger = logger;
+  _held.fill(0);
+  _cursor = 0;
+  _updated = false;
+  return true;
+}
+
+bool headless::Input::parse(char const* text, uint16_t* const buttons)
+{
+  static char const* const names[] =
+  {
+    "b", "y", "select", "start", "up", "down", "left", "right",
+    "a", "x", "l", "r", "l2", "r2", "l3", "r3"
+  };
+
+  *buttons = 0;
+
+  if (strcmp(text, "-") == 0)
+  {
+    return true;
+  }
+  else if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+  {
+    char* end;
+    unsigned long const mask = strtoul(text + 2, &end, 16);
+
+    if (*end != 0 || end == text + 2 || mask > 0xffff)
+    {
+      return false;
+    }
+
+    *buttons = static_cast<uint16_t>(mask);
+    return true;
+  }
+
+  while (*text != 0)
+  {
+    size_t const length = strcspn(text, "+");
+    unsigned id = 0;
+
+    while (id < sizeof(names) / sizeof(names[0]) && (strlen(names[id]) != length || strncmp(names[id], text, length) != 0))
+    {
+      id++;
+    }
+
+    if (id == sizeof(names) / sizeof(names[0]))
+    {
+      return false;
+    }
+
+    *buttons |= 1 << id;
+    text += length;
+
+    if (*text == '+')
+    {
+      text++;
+    }
+  }
+
+  return true;
+}
+
+void headless::Input::hold(unsigned const port, uint16_t const buttons)
+{
+  if (port < kMaxPorts)
+  {
+    _held[port] = buttons;
+  }
+}
+
+bool headless::Input::replay(char const* const path, std::string* const error)
+{
+  FILE* file = fopen(path, "r");
+
+  if (file == NULL)
+  {
+    *error = std::string("Error opening ") + path + ": " + strerror(errno);
+    return false;
+  }
+
+  std::vector<State> states;
+  char line[1024];
+  unsigned number = 0;
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    number++;
+
+    State state;
+    state.fill(0);
+
+    char* saveptr;
+    char* token = strtok_r(line, " \t\r\n", &saveptr);
+
+    for (unsigned port = 0; token != NULL; port++)
+    {
+      if (port == kMaxPorts || !parse(token, &state[port]))
+      {
+        char message[128];
+        snprintf(message, sizeof(message), "%s:%u: invalid input state", path, number);
+        *error = message;
+        fclose(file);
+        return false;
+      }
+
+      token = strtok_r(NULL, " \t\r\n", &saveptr);
+    }
+
+    states.emplace_back(state);
+  }
+
+  fclose(file);
+
+  _replay = std::move(states);
+  _cursor = 0;
+  return true;
+}
+
+void headless::Input::setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs)
+{
+  (void)descs;
+}
+
+void headless::Input::setControllerInfo(std::vector<libretro::ControllerInfo> const& info)
+{
+  (void)info;
+  _updated = true;
+}
+
+bool headless::Input::ctrlUpdated()
+{
+  bool updated = _updated;
+  _updated = false;
+  return updated;
+}
+
+unsigned headless::Input::getController(unsigned port)
+{
+  return port < kMaxPorts ? RETRO_DEVICE_JOYPAD : RETRO_DEVICE_NONE;
+}
+
+void headless::Input::poll()
+{
+}
+
+int16_t headless::Input::read(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+  if (port >= kMaxPorts || device != RETRO_DEVICE_JOYPAD || index != 0)
+  {
+    return 0;
+  }
+
+  uint16_t const buttons = _cursor < _replay.size() ? _replay[_cursor][port] : _held[port];
+
+  if (id == RETRO_DEVICE_ID_JOYPAD_MASK)
+  {
+    return static_cast<int16_t>(buttons);
+  }
+
+  return id < 16 ? (buttons >> id) & 1 : 0;
+}
+
+void headless::Input::frame(libretro::CoreManager* const core, uint64_t const frame)
+{
+  (void)core;
+  (void)frame;
+
+  if (_cursor < _replay.size())
+  {
+    _cursor++;
+  }
+}
+
+bool headless::Loader::init(libretro::LoggerComponent* logger)
+{
+  _logger = logger;
+  return true;
+}
+
+void* headless::Loader::load(size_t* size, std::string const& path)
+{
+  FILE* file = fopen(path.c_str(), "rb");
+
+  if (file == NULL)
+  {
+    _logger->printf(RETRO_LOG_ERROR, "Error opening content: %s", strerror(errno));
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long const length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  void* data = length >= 0 ? malloc(length != 0 ? length : 1) : NULL;
+
+  if (data == NULL)
+  {
+    _logger->printf(RETRO_LOG_ERROR, "Out of memory allocating %ld bytes", length);
+    fclose(file);
+    return NULL;
+  }
+
+  if (fread(data, 1, length, file) != static_cast<size_t>(length))
+  {
+    _logger->printf(RETRO_LOG_ERROR, "Error reading content: %s", strerror(errno));
+    ::free(data);
+    fclose(file);
+    return NULL;
+  }
+
+  fclose(file);
+  *size = length;
+  return data;
+}
+
+void headless::Loader::free(void* data)
+{
+  ::free(data);
+}
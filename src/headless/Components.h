@@ -0,0 +1,134 @@
+#pragma once
+
+#include "libretro/CoreManager.h"
+
+#include <array>
+#include <map>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Components for running a core without a window, audio device or input
+ * devices. Video and audio are discarded, input comes from the script.
+ */
+namespace headless
+{
+  class Logger: public libretro::LoggerComponent
+  {
+  public:
+    bool init(enum retro_log_level const level);
+
+    virtual void vprintf(enum retro_log_level level, const char* fmt, va_list args) override;
+
+  protected:
+    enum retro_log_level _level;
+  };
+
+  class Config: public libretro::ConfigComponent
+  {
+  public:
+    bool init(libretro::LoggerComponent* logger, std::string const& directory);
+
+    // Selects an option for a variable, before or after the core sets them.
+    void setOption(std::string const& key, std::string const& value);
+
+    virtual std::string const& getCoreAssetsDirectory() override;
+    virtual std::string const& getSaveDirectory() override;
+    virtual std::string const& getSystemPath() override;
+
+    virtual void setVariables(std::vector<libretro::Variable> const& variables) override;
+    virtual bool varUpdated() override;
+    virtual std::string const& getVariable(std::string const& variable) override;
+
+  protected:
+    libretro::LoggerComponent* _logger;
+    std::string _directory;
+
+    std::map<std::string, std::string> _options;
+    std::map<std::string, std::string> _values;
+    bool _updated;
+  };
+
+  class Video: public libretro::VideoComponent
+  {
+  public:
+    bool init(libretro::LoggerComponent* logger);
+
+    virtual bool setGeometry(unsigned width, unsigned height, float aspect, enum retro_pixel_format pixelFormat) override;
+    virtual void refresh(const void* data, unsigned width, unsigned height, size_t pitch) override;
+
+    virtual uintptr_t getCurrentFramebuffer() override;
+
+    virtual void showMessage(std::string const& msg, unsigned frames) override;
+
+  protected:
+    libretro::LoggerComponent* _logger;
+  };
+
+  class Audio: public libretro::AudioComponent
+  {
+  public:
+    virtual bool setRate(double rate) override;
+    virtual void mix(const int16_t* samples, size_t frames) override;
+  };
+
+  /**
+   * Joypads whose buttons are either held until changed, or replayed from an
+   * input file with the state of every port for each frame, one frame per
+   * line. Each state is a list of button names joined by +, a hexadecimal
+   * mask of RETRO_DEVICE_ID_JOYPAD_* bits starting with 0x, or - for none.
+   */
+  class Input: public libretro::InputComponent, public libretro::FrameListener
+  {
+  public:
+    enum
+    {
+      kMaxPorts = 4
+    };
+
+    bool init(libretro::LoggerComponent* logger);
+
+    static bool parse(char const* text, uint16_t* const buttons);
+
+    void hold(unsigned const port, uint16_t const buttons);
+
+    // The replay starts with the next frame.
+    bool replay(char const* const path, std::string* const error);
+    size_t remaining() const { return _replay.size() - _cursor; }
+
+    virtual void setInputDescriptors(std::vector<libretro::InputDescriptor> const& descs) override;
+
+    virtual void     setControllerInfo(std::vector<libretro::ControllerInfo> const& info) override;
+    virtual bool     ctrlUpdated() override;
+    virtual unsigned getController(unsigned port) override;
+
+    virtual void    poll() override;
+    virtual int16_t read(unsigned port, unsigned device, unsigned index, unsigned id) override;
+
+    virtual void frame(libretro::CoreManager* const core, uint64_t const frame) override;
+
+  protected:
+    typedef std::array<uint16_t, kMaxPorts> State;
+
+    libretro::LoggerComponent* _logger;
+
+    State              _held;
+    std::vector<State> _replay;
+    size_t             _cursor;
+    bool               _updated;
+  };
+
+  class Loader: public libretro::LoaderComponent
+  {
+  public:
+    bool init(libretro::LoggerComponent* logger);
+
+    virtual void* load(size_t* size, std::string const& path) override;
+    virtual void  free(void* data) override;
+
+  protected:
+    libretro::LoggerComponent* _logger;
+  };
+}
@@ -0,0 +1,758 @@
+#include "Components.h"
+
+#include "Candidates.h"
+#include "Memory.h"
+#include "Movie.h"
+#include "Snapshot.h"
+#include "Value.h"
+
+#include <errno.h>
+#include <functional>
+#include <limits.h>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+static char const s_usage[] =
+  "Usage: ch-headless [-v] [-d directory] [-o key=value]... core content [script]...\n"
+  "\n"
+  "Runs the script, or the commands read from stdin, on the content. Several\n"
+  "scripts run in parallel, each on its own copy of the core.\n"
+  "\n"
+  "  run FRAMES                     run frames as fast as possible\n"
+  "  hold PORT BUTTONS              hold buttons, e.g. a+right, until changed\n"
+  "  input FILE                     replay the input file from the next frame\n"
+  "  save FILE                      save the core state to a file\n"
+  "  load FILE                      load the core state from a file\n"
+  "  snap                           start a search with the current memory\n"
+  "  filter SIZE FORMAT OP [VALUE]  keep the candidates where the current value\n"
+  "                                 compares to VALUE, or to the previous one\n"
+  "  print [MAX]                    list the candidates with their region\n"
+  "                                 and current value\n"
+  "  peek ADDRESS SIZE FORMAT       print the value at an address\n"
+  "  capture FILE                   write all memory regions to a file\n"
+  "  record FILE [CHECK]            record a movie from the current frame,\n"
+  "                                 with hashes of memory, state or all\n"
+  "  play FILE                      load the start of a movie and replay it\n"
+  "  stop                           stop recording or replaying the movie\n"
+  "  frame                          print the frame count\n"
+  "\n"
+  "SIZE is 8, 16, 24 or 32, FORMAT is le, be, bcdle or bcdbe, and OP is one of\n"
+  "<, <=, >, >=, == and !=. Lines starting with # are ignored.\n";
+
+class Headless
+{
+protected:
+  headless::Logger _logger;
+  headless::Config _config;
+  headless::Video  _video;
+  headless::Audio  _audio;
+  headless::Input  _input;
+  headless::Loader _loader;
+
+  libretro::CoreManager _core;
+  Memory                _memory;
+  Movie                 _movie;
+  FILE*                 _output;
+
+  // One per memory region, empty when there's no search.
+  std::vector<Candidates> _candidates;
+  unsigned                _generation;
+  Snapshot::Size          _bits;
+  Snapshot::Format        _format;
+
+  static bool parseSize(char const* text, Snapshot::Size* const bits)
+  {
+    static char const* const sizes[] = {"8", "16", "24", "32"};
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+      if (strcmp(text, sizes[i]) == 0)
+      {
+        *bits = static_cast<Snapshot::Size>(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static bool parseFormat(char const* text, Snapshot::Format* const format)
+  {
+    static char const* const formats[] = {"le", "be", "bcdle", "bcdbe"};
+
+    for (unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+      if (strcmp(text, formats[i]) == 0)
+      {
+        *format = static_cast<Snapshot::Format>(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static bool parseOperator(char const* text, Snapshot::Operator* const op)
+  {
+    static char const* const operators[] = {"<", "<=", ">", ">=", "==", "!="};
+
+    for (unsigned i = 0; i < sizeof(operators) / sizeof(operators[0]); i++)
+    {
+      if (strcmp(text, operators[i]) == 0)
+      {
+        *op = static_cast<Snapshot::Operator>(i);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  static bool parseNumber(char const* text, unsigned long const max, unsigned long* const number)
+  {
+    char* end;
+    errno = 0;
+    *number = strtoul(text, &end, 0);
+    return errno == 0 && end != text && *end == 0 && *number <= max;
+  }
+
+  static void writeLittleEndian(FILE* file, uint32_t const value)
+  {
+    uint8_t const bytes[4] = {
+      static_cast<uint8_t>(value),
+      static_cast<uint8_t>(value >> 8),
+      static_cast<uint8_t>(value >> 16),
+      static_cast<uint8_t>(value >> 24)
+    };
+
+    fwrite(bytes, 1, sizeof(bytes), file);
+  }
+
+  bool run(unsigned long const frames)
+  {
+    // Nobody looks at the frames, let the core skip audio and video
+    for (unsigned long i = 0; i < frames; i++)
+    {
+      _core.skipFrame();
+    }
+
+    _memory.update();
+    return true;
+  }
+
+  bool save(char const* const path, std::string* const error)
+  {
+    std::vector<uint8_t> state(_core.serializeSize());
+
+    if (state.empty() || !_core.serialize(state.data(), state.size()))
+    {
+      *error = "Error saving the state";
+      return false;
+    }
+
+    FILE* file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+      *error = std::string("Error creating ") + path + ": " + strerror(errno);
+      return false;
+    }
+
+    fwrite(state.data(), 1, state.size(), file);
+
+    if (fclose(file) != 0)
+    {
+      *error = std::string("Error writing ") + path + ": " + strerror(errno);
+      return false;
+    }
+
+    return true;
+  }
+
+  bool load(char const* const path, std::string* const error)
+  {
+    size_t size;
+    void* const state = _loader.load(&size, path);
+
+    if (state == NULL)
+    {
+      *error = std::string("Error reading ") + path;
+      return false;
+    }
+
+    // The file is a bare core state, the frame count goes on from here
+    bool const ok = _core.unserialize(state, size, _core.getFrameCount());
+    _loader.free(state);
+
+    if (!ok)
+    {
+      *error = "Error loading the state";
+      return false;
+    }
+
+    _memory.update();
+    return true;
+  }
+
+  bool snap()
+  {
+    _candidates.clear();
+
+    for (auto const& snapshot : _memory.clickAll())
+    {
+      _candidates.emplace_back(snapshot);
+    }
+
+    _generation = _memory.generation();
+    fprintf(_output, "%zu candidates\n", count());
+    return true;
+  }
+
+  bool filter(Snapshot::Size const bits, Snapshot::Format const format, Snapshot::Operator const op, bool const hasValue, uint32_t const value, std::string* const error)
+  {
+    if (_candidates.empty())
+    {
+      *error = "No search, use snap first";
+      return false;
+    }
+    else if (_generation != _memory.generation())
+    {
+      *error = "The memory regions have changed since the snap";
+      return false;
+    }
+
+    std::vector<Snapshot> const snapshots = _memory.clickAll();
+
+    // Check every region first so that a mismatch leaves the search as it was
+    for (size_t i = 0; i < _candidates.size(); i++)
+    {
+      if (i >= snapshots.size() || !_candidates[i].matches(snapshots[i]))
+      {
+        *error = "The memory regions have changed since the snap";
+        return false;
+      }
+    }
+
+    for (size_t i = 0; i < _candidates.size(); i++)
+    {
+      if (hasValue)
+      {
+        _candidates[i].update(snapshots[i], error);
+        _candidates[i].filter(bits, format, op, value);
+      }
+      else
+      {
+        _candidates[i].filter(bits, format, op, snapshots[i], error);
+      }
+    }
+
+    _bits = bits;
+    _format = format;
+
+    fprintf(_output, "%zu candidates\n", count());
+    return true;
+  }
+
+  bool print(unsigned long const max, std::string* const error)
+  {
+    if (_candidates.empty())
+    {
+      *error = "No search, use snap first";
+      return false;
+    }
+    else if (_generation != _memory.generation())
+    {
+      *error = "The memory regions have changed since the snap";
+      return false;
+    }
+
+    // Regions from RETRO_MEMORY_* all start at address 0, so the value is
+    // read from the candidate's region and the region is printed too
+    std::vector<Memory::Region> const& regions = _memory.regions();
+    size_t const width = sizeOf(_bits);
+    unsigned long printed = 0;
+
+    for (size_t i = 0; i < _candidates.size(); i++)
+    {
+      Memory::Region const& region = regions[i];
+
+      for (auto const address : _candidates[i].toSet())
+      {
+        if (printed == max)
+        {
+          return true;
+        }
+
+        size_t const offset = address - region.address;
+
+        if (offset + width <= region.size)
+        {
+          uint32_t const value = read(_bits, _format, static_cast<uint8_t const*>(region.data) + offset);
+          fprintf(_output, "%zu 0x%08x %u\n", i, address, value);
+        }
+        else
+        {
+          fprintf(_output, "%zu 0x%08x -\n", i, address);
+        }
+
+        printed++;
+      }
+    }
+
+    return true;
+  }
+
+  bool capture(char const* const path, std::string* const error)
+  {
+    FILE* file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+      *error = std::string("Error creating ") + path + ": " + strerror(errno);
+      return false;
+    }
+
+    // Each region is its address and size, then its contents
+    for (auto const& region : _memory.regions())
+    {
+      writeLittleEndian(file, region.address);
+      writeLittleEndian(file, static_cast<uint32_t>(region.size));
+      fwrite(region.data, 1, region.size, file);
+    }
+
+    if (fclose(file) != 0)
+    {
+      *error = std::string("Error writing ") + path + ": " + strerror(errno);
+      return false;
+    }
+
+    return true;
+  }
+
+  size_t count() const
+  {
+    size_t total = 0;
+
+    for (auto const& candidates : _candidates)
+    {
+      total += candidates.count();
+    }
+
+    return total;
+  }
+
+  bool execute(char* const line, std::string* const error)
+  {
+    char* args[8];
+    unsigned argc = 0;
+
+    char* saveptr;
+    char* token = strtok_r(line, " \t\r\n", &saveptr);
+
+    while (token != NULL && argc < sizeof(args) / sizeof(args[0]))
+    {
+      args[argc++] = token;
+      token = strtok_r(NULL, " \t\r\n", &saveptr);
+    }
+
+    if (argc == 0 || args[0][0] == '#')
+    {
+      return true;
+    }
+    else if (token != NULL)
+    {
+      *error = "Too many arguments";
+      return false;
+    }
+
+    char const* const command = args[0];
+    unsigned long number;
+
+    if (strcmp(command, "run") == 0 && argc == 2)
+    {
+      if (!parseNumber(args[1], ULONG_MAX, &number))
+      {
+        *error = "Invalid number of frames";
+        return false;
+      }
+
+      return run(number);
+    }
+    else if (strcmp(command, "hold") == 0 && argc == 3)
+    {
+      uint16_t buttons;
+
+      if (!parseNumber(args[1], headless::Input::kMaxPorts - 1, &number))
+      {
+        *error = "Invalid port";
+        return false;
+      }
+      else if (!headless::Input::parse(args[2], &buttons))
+      {
+        *error = "Invalid buttons";
+        return false;
+      }
+
+      _input.hold(number, buttons);
+      return true;
+    }
+    else if (strcmp(command, "input") == 0 && argc == 2)
+    {
+      return _input.replay(args[1], error);
+    }
+    else if (strcmp(command, "save") == 0 && argc == 2)
+    {
+      return save(args[1], error);
+    }
+    else if (strcmp(command, "load") == 0 && argc == 2)
+    {
+      return load(args[1], error);
+    }
+    else if (strcmp(command, "snap") == 0 && argc == 1)
+    {
+      return snap();
+    }
+    else if (strcmp(command, "filter") == 0 && (argc == 4 || argc == 5))
+    {
+      Snapshot::Size bits;
+      Snapshot::Format format;
+      Snapshot::Operator op;
+
+      if (!parseSize(args[1], &bits) || !parseFormat(args[2], &format) || !parseOperator(args[3], &op))
+      {
+        *error = "Invalid size, format or operator";
+        return false;
+      }
+      else if (argc == 5 && !parseNumber(args[4], UINT32_MAX, &number))
+      {
+        *error = "Invalid value";
+        return false;
+      }
+
+      return filter(bits, format, op, argc == 5, argc == 5 ? number : 0, error);
+    }
+    else if (strcmp(command, "print") == 0 && (argc == 1 || argc == 2))
+    {
+      if (argc == 2 && !parseNumber(args[1], ULONG_MAX, &number))
+      {
+        *error = "Invalid maximum";
+        return false;
+      }
+
+      return print(argc == 2 ? number : 100, error);
+    }
+    else if (strcmp(command, "peek") == 0 && argc == 4)
+    {
+      Snapshot::Size bits;
+      Snapshot::Format format;
+      uint32_t value;
+
+      if (!parseNumber(args[1], UINT32_MAX, &number) || !parseSize(args[2], &bits) || !parseFormat(args[3], &format))
+      {
+        *error = "Invalid address, size or format";
+        return false;
+      }
+      else if (!_memory.peek(number, bits, format, &value))
+      {
+        *error = "The address isn't mapped";
+        return false;
+      }
+
+      fprintf(_output, "0x%08lx %u\n", number, value);
+      return true;
+    }
+    else if (strcmp(command, "capture") == 0 && argc == 2)
+    {
+      return capture(args[1], error);
+    }
+    else if (strcmp(command, "record") == 0 && (argc == 2 || argc == 3))
+    {
+      bool const all = argc == 3 && strcmp(args[2], "all") == 0;
+      bool const memory = all || (argc == 3 && strcmp(args[2], "memory") == 0);
+      bool const state = all || (argc == 3 && strcmp(args[2], "state") == 0);
+      std::vector<size_t> regions;
+
+      if (argc == 3 && !memory && !state)
+      {
+        *error = "Invalid check";
+        return false;
+      }
+
+      for (size_t i = 0; memory && i < _memory.regions().size(); i++)
+      {
+        regions.push_back(i);
+      }
+
+      return _movie.record(args[1], regions, state, error);
+    }
+    else if (strcmp(command, "play") == 0 && argc == 2)
+    {
+      return _movie.play(args[1], error);
+    }
+    else if (strcmp(command, "stop") == 0 && argc == 1)
+    {
+      return _movie.stop(error);
+    }
+    else if (strcmp(command, "frame") == 0 && argc == 1)
+    {
+      fprintf(_output, "%llu\n", static_cast<unsigned long long>(_core.getFrameCount()));
+      return true;
+    }
+
+    *error = std::string("Unknown command or wrong number of arguments: ") + command;
+    return false;
+  }
+
+public:
+  struct Options
+  {
+    std::string          corePath;
+    std::string          contentPath;
+    std::string          directory;
+    enum retro_log_level level;
+    bool                 privateCopy;
+
+    std::vector<std::pair<std::string, std::string>> variables;
+  };
+
+  bool init(Options const& options, FILE* const output)
+  {
+    _logger.init(options.level);
+    _config.init(&_logger, options.directory);
+    _video.init(&_logger);
+    _input.init(&_logger);
+    _loader.init(&_logger);
+    _memory.init(&_core);
+    _movie.init(&_core, &_memory, &_input, &_logger);
+    _movie.setContent(options.corePath, options.contentPath);
+
+    for (auto const& variable : options.variables)
+    {
+      _config.setOption(variable.first, variable.second);
+    }
+
+    _output = output;
+    _generation = 0;
+    _bits = Snapshot::Size::_8;
+    _format = Snapshot::Format::UIntLittleEndian;
+
+    _core.init(&_logger, &_config, &_video, &_audio, &_movie, &_loader);
+    _core.addFrameListener(&_input);
+    _core.addFrameListener(&_movie);
+
+    if (!_core.loadCore(options.corePath, options.privateCopy) || !_core.loadGame(options.contentPath))
+    {
+      _core.removeFrameListener(&_movie);
+      _core.removeFrameListener(&_input);
+      return false;
+    }
+
+    _memory.update();
+    return true;
+  }
+
+  void destroy()
+  {
+    _candidates.clear();
+    _movie.destroy();
+    _memory.destroy();
+    _core.destroy();
+    _core.removeFrameListener(&_movie);
+    _core.removeFrameListener(&_input);
+  }
+
+  bool run(FILE* const script, char const* const name)
+  {
+    char line[1024];
+    unsigned number = 0;
+
+    while (fgets(line, sizeof(line), script) != NULL)
+    {
+      number++;
+      std::string error;
+
+      if (!execute(line, &error))
+      {
+        fprintf(stderr, "%s:%u: %s\n", name, number, error.c_str());
+        return false;
+      }
+
+      fflush(_output);
+    }
+
+    return true;
+  }
+};
+
+// A script run on its own instance of the core, on its own thread.
+struct Job
+{
+  std::string name;
+  FILE*       script;
+  FILE*       output;
+  bool        ok;
+  Headless    headless;
+
+  void run(Headless::Options const& options)
+  {
+    ok = headless.init(options, output);
+
+    if (ok)
+    {
+      ok = headless.run(script, name.c_str());
+      headless.destroy();
+    }
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  Headless::Options options;
+  options.directory = ".";
+  options.level = RETRO_LOG_WARN;
+  options.privateCopy = false;
+
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++)
+  {
+    if (strcmp(argv[i], "-v") == 0)
+    {
+      options.level = RETRO_LOG_DEBUG;
+    }
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+    {
+      options.directory = argv[++i];
+    }
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc && strchr(argv[i + 1], '=') != NULL)
+    {
+      char const* const variable = argv[++i];
+      char const* const equal = strchr(variable, '=');
+      options.variables.emplace_back(std::string(variable, equal - variable), std::string(equal + 1));
+    }
+    else
+    {
+      fputs(s_usage, stderr);
+      return 1;
+    }
+  }
+
+  if (argc - i < 2)
+  {
+    fputs(s_usage, stderr);
+    return 1;
+  }
+
+  options.corePath = argv[i];
+  options.contentPath = argv[i + 1];
+
+  if (argc - i <= 3)
+  {
+    char const* name = "stdin";
+    FILE* script = stdin;
+
+    if (argc - i == 3 && strcmp(argv[i + 2], "-") != 0)
+    {
+      name = argv[i + 2];
+      script = fopen(name, "r");
+
+      if (script == NULL)
+      {
+        fprintf(stderr, "Error opening %s: %s\n", name, strerror(errno));
+        return 1;
+      }
+    }
+
+    Headless headless;
+    bool ok = headless.init(options, stdout);
+
+    if (ok)
+    {
+      ok = headless.run(script, name);
+      headless.destroy();
+    }
+
+    if (script != stdin)
+    {
+      fclose(script);
+    }
+
+    return ok ? 0 : 1;
+  }
+
+  // With more than one script, the instances can't share the core's globals;
+  // their output is kept aside and written in the order of the scripts
+  options.privateCopy = true;
+
+  std::vector<std::unique_ptr<Job>> jobs;
+  bool ok = true;
+
+  for (i += 2; i < argc && ok; i++)
+  {
+    std::unique_ptr<Job> job(new Job);
+    job->name = argv[i];
+    job->script = fopen(argv[i], "r");
+    job->output = tmpfile();
+    job->ok = false;
+
+    if (job->script == NULL || job->output == NULL)
+    {
+      fprintf(stderr, "Error opening %s: %s\n", argv[i], strerror(errno));
+      ok = false;
+    }
+
+    jobs.emplace_back(std::move(job));
+  }
+
+  bool const started = ok;
+
+  if (started)
+  {
+    std::vector<std::thread> threads;
+
+    for (auto const& job : jobs)
+    {
+      threads.emplace_back(&Job::run, job.get(), std::cref(options));
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  for (auto const& job : jobs)
+  {
+    if (started)
+    {
+      printf("==> %s <==\n", job->name.c_str());
+      rewind(job->output);
+
+      char buffer[4096];
+      size_t count;
+
+      while ((count = fread(buffer, 1, sizeof(buffer), job->output)) != 0)
+      {
+        fwrite(buffer, 1, count, stdout);
+      }
+    }
+
+    ok = ok && job->ok;
+
+    if (job->script != NULL)
+    {
+      fclose(job->script);
+    }
+
+    if (job->output != NULL)
+    {
+      fclose(job->output);
+    }
+  }
+
+  return ok ? 0 : 1;
+}
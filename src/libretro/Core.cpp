@@ -26,9 +26,20 @@ SOFTWARE.
 
 #include <sys/stat.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 #define CORE_DLSYM(prop, name) \
   do { \
     void* sym = dynlib_symbol(_handle, name); \
@@ -36,7 +47,59 @@ SOFTWARE.
     memcpy(&prop, &sym, sizeof(prop)); \
   } while (0)
 
+#ifndef _WIN32
+static bool copyFile(char const* const path, int const fd, std::string* const error) {
+  int const source = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (source < 0) {
+    if (error != nullptr) {
+      *error = std::string("open: ") + strerror(errno);
+    }
+
+    return false;
+  }
+
+  char buffer[65536];
+
+  for (;;) {
+    ssize_t const count = read(source, buffer, sizeof(buffer));
+
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    else if (count <= 0) {
+      if (count < 0 && error != nullptr) {
+        *error = std::string("read: ") + strerror(errno);
+      }
+
+      close(source);
+      return count == 0;
+    }
+
+    for (ssize_t done = 0; done < count;) {
+      ssize_t const written = write(fd, buffer + done, count - done);
+
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      else if (written < 0) {
+        if (error != nullptr) {
+          *error = std::string("write: ") + strerror(errno);
+        }
+
+        close(source);
+        return false;
+      }
+
+      done += written;
+    }
+  }
+}
+#endif
+
 bool libretro::Core::load(std::string const& path, std::string* const error) {
+  _copyFd = -1;
+  _copyPath.clear();
   _handle = dynlib_open(path.c_str());
 
   if (_handle == NULL) {
@@ -47,6 +110,95 @@ bool libretro::Core::load(std::string const& path, std::string* const error) {
     return false;
   }
 
+  return resolve(error);
+}
+
+bool libretro::Core::loadCopy(std::string const& path, std::string* const error) {
+  _handle = NULL;
+  _copyFd = -1;
+  _copyPath.clear();
+
+#if defined(__linux__)
+  // The copy lives in memory, and is gone when the last mapping and the
+  // descriptor are
+  int const fd = memfd_create("core", MFD_CLOEXEC);
+
+  if (fd < 0) {
+    if (error != nullptr) {
+      *error = std::string("memfd_create: ") + strerror(errno);
+    }
+
+    return false;
+  }
+
+  if (!copyFile(path.c_str(), fd, error)) {
+    close(fd);
+    return false;
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "/proc/self/fd/%d", fd);
+
+  _handle = dynlib_open(name);
+
+  if (_handle != NULL) {
+    _copyFd = fd;
+  }
+  else {
+    close(fd);
+  }
+#elif !defined(_WIN32)
+  char const* const directory = getenv("TMPDIR");
+  std::string name = std::string(directory != nullptr ? directory : "/tmp") + "/coreXXXXXX";
+  int const fd = mkstemp(&name[0]);
+
+  if (fd < 0) {
+    if (error != nullptr) {
+      *error = std::string("mkstemp: ") + strerror(errno);
+    }
+
+    return false;
+  }
+
+  bool const ok = copyFile(path.c_str(), fd, error);
+  close(fd);
+
+  _handle = ok ? dynlib_open(name.c_str()) : NULL;
+
+  if (_handle != NULL) {
+    _copyPath = name;
+  }
+  else {
+    unlink(name.c_str());
+  }
+
+  if (!ok) {
+    return false;
+  }
+#else
+  (void)path;
+
+  if (error != nullptr) {
+    *error = "Private copies of cores aren't supported on this platform";
+  }
+
+  return false;
+#endif
+
+#ifndef _WIN32
+  if (_handle == NULL) {
+    if (error != nullptr) {
+      *error = dynlib_error();
+    }
+
+    return false;
+  }
+
+  return resolve(error);
+#endif
+}
+
+bool libretro::Core::resolve(std::string* const error) {
   CORE_DLSYM(_init, "retro_init");
   CORE_DLSYM(_deinit, "retro_deinit");
   CORE_DLSYM(_apiVersion, "retro_api_version");
@@ -81,11 +233,32 @@ error:
   }
   
   dynlib_close(_handle);
+  _handle = NULL;
+  releaseCopy();
   return false;
 }
 
 #undef CORE_DLSYM
 
 void libretro::Core::destroy() {
-  dynlib_close(_handle);
+  if (_handle != NULL) {
+    dynlib_close(_handle);
+    _handle = NULL;
+  }
+
+  releaseCopy();
+}
+
+void libretro::Core::releaseCopy() {
+#ifndef _WIN32
+  if (_copyFd >= 0) {
+    close(_copyFd);
+    _copyFd = -1;
+  }
+
+  if (!_copyPath.empty()) {
+    unlink(_copyPath.c_str());
+    _copyPath.clear();
+  }
+#endif
 }
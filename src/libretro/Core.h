@@ -41,12 +41,21 @@ namespace libretro {
    */
   class Core {
   public:
+    Core() : _handle(NULL), _copyFd(-1) {}
+
     // Loads a core specified by its file path.
     bool load(std::string const& path, std::string* const error);
+
+    // Loads a private copy of the core, so that its global state isn't
+    // shared with other instances loaded from the same file. dlopen returns
+    // the same handle for a file that is already loaded.
+    bool loadCopy(std::string const& path, std::string* const error);
     
-    // Unloads the core from memory.
+    // Unloads the core from memory, does nothing if it isn't loaded.
     void destroy();
 
+    bool loaded() const { return _handle != NULL; }
+
     // All the remaining methods map 1:1 to the libretro API.
     void     init()                                                   const { _init(); }
     void     deinit()                                                 const { _deinit(); }
@@ -79,8 +88,17 @@ namespace libretro {
     size_t   getMemorySize(unsigned id) const { return _getMemorySize(id); }
 
   protected:
+    bool resolve(std::string* const error);
+    void releaseCopy();
+
     dynlib_t _handle;
 
+    // The file of a private copy stays until the core is unloaded, dlopen
+    // would otherwise return this core for a new copy that gets the same
+    // name.
+    int         _copyFd;
+    std::string _copyPath;
+
     void     (*_init)();
     void     (*_deinit)();
     unsigned (*_apiVersion)();
@@ -24,6 +24,7 @@ SOFTWARE.
 
 #include "CoreManager.h"
 
+#include <algorithm>
 #include <stdlib.h>
 #include <string.h>
 
@@ -51,8 +52,10 @@ namespace {
   };
 }
 
-// Helper function for the memory map interface
+// Helper functions for the memory map interface
 static bool preprocessMemoryDescriptors(std::vector<libretro::MemoryDescriptor>* memoryMap);
+static size_t reduce(size_t addr, size_t mask);
+static size_t highestBit(size_t n);
 
 bool libretro::CoreManager::init(LoggerComponent* const logger,
                                  ConfigComponent* const config,
@@ -74,16 +77,17 @@ bool libretro::CoreManager::init(LoggerComponent* const logger,
   return true;
 }
 
-bool libretro::CoreManager::loadCore(std::string const& corePath) {
+bool libretro::CoreManager::loadCore(std::string const& corePath, bool const privateCopy) {
   InstanceSetter instance_setter(this);
 
-  info("Opening core \"%s\"", corePath.c_str());
+  info("Opening core \"%s\"%s", corePath.c_str(), privateCopy ? " (private copy)" : "");
   _libretroPath = corePath;
 
   std::string message;
+  bool const ok = privateCopy ? _core.loadCopy(corePath, &message) : _core.load(corePath, &message);
   
-  if (!_core.load(corePath, &message)) {
-    error("Error opening core \"%s\": %s", corePath, message.c_str());
+  if (!ok) {
+    error("Error opening core \"%s\": %s", corePath.c_str(), message.c_str());
     return false;
   }
 
@@ -164,18 +168,84 @@ error:
 void libretro::CoreManager::destroy() {
   InstanceSetter instance_setter(this);
 
-  if (_gameLoaded) {
-    _core.unloadGame();
+  // A failed loadGame already unloaded the core
+  if (_core.loaded()) {
+    if (_gameLoaded) {
+      _core.unloadGame();
+    }
+
+    _core.deinit();
+    _core.destroy();
   }
 
-  _core.deinit();
-  _core.destroy();
   reset();
 }
 
 void libretro::CoreManager::step() {
+  step(kEnableVideo | kEnableAudio);
+}
+
+void libretro::CoreManager::stepWithoutVideo() {
+  step(kEnableAudio);
+}
+
+void libretro::CoreManager::step(int const audioVideoEnable) {
+  InstanceSetter instance_setter(this);
+
+  updatePorts();
+  _samplesCount = 0;
+  _audioVideoEnable = audioVideoEnable;
+
+  do {
+    runFrame();
+  }
+  while (_samplesCount == 0);
+
+  _audioVideoEnable = kEnableVideo | kEnableAudio;
+  _audio->mix(_samples, _samplesCount / 2);
+}
+
+void libretro::CoreManager::skipFrame() {
+  InstanceSetter instance_setter(this);
+
+  updatePorts();
+
+  _audioVideoEnable = 0;
+  runFrame();
+  _audioVideoEnable = kEnableVideo | kEnableAudio;
+
+  _samplesCount = 0;
+}
+
+void libretro::CoreManager::replayFrame() {
   InstanceSetter instance_setter(this);
 
+  updatePorts();
+
+  _audioVideoEnable = 0;
+  _core.run();
+  _frameCount++;
+  _audioVideoEnable = kEnableVideo | kEnableAudio;
+
+  _samplesCount = 0;
+}
+
+void libretro::CoreManager::runAhead(unsigned const frames) {
+  InstanceSetter instance_setter(this);
+
+  updatePorts();
+
+  for (unsigned i = 1; i <= frames; i++) {
+    _audioVideoEnable = i == frames ? kEnableVideo : 0;
+    _core.run();
+    _frameCount++;
+  }
+
+  _audioVideoEnable = kEnableVideo | kEnableAudio;
+  _samplesCount = 0;
+}
+
+void libretro::CoreManager::updatePorts() {
   if (_input->ctrlUpdated()) {
     size_t const count = getControllerInfo().size();
 
@@ -188,15 +258,145 @@ void libretro::CoreManager::step() {
       }
     }
   }
+}
 
-  _samplesCount = 0;
+void libretro::CoreManager::runFrame() {
+  InstanceSetter instance_setter(this);
 
-  do {
-    _core.run();
+  _core.run();
+  _frameCount++;
+
+  for (auto const listener : _frameListeners) {
+    listener->frame(this, _frameCount);
+  }
+}
+
+size_t libretro::CoreManager::serializeSize() {
+  InstanceSetter instance_setter(this);
+  return _core.serializeSize();
+}
+
+bool libretro::CoreManager::serialize(void* const data, size_t const size) {
+  InstanceSetter instance_setter(this);
+  return _core.serialize(data, size);
+}
+
+bool libretro::CoreManager::unserialize(void const* const data, size_t const size, uint64_t const frame) {
+  InstanceSetter instance_setter(this);
+
+  if (!_core.unserialize(data, size)) {
+    return false;
+  }
+
+  _frameCount = frame;
+  return true;
+}
+
+void libretro::CoreManager::addFrameListener(FrameListener* const listener) {
+  _frameListeners.emplace_back(listener);
+}
+
+void libretro::CoreManager::removeFrameListener(FrameListener* const listener) {
+  _frameListeners.erase(std::remove(_frameListeners.begin(), _frameListeners.end(), listener), _frameListeners.end());
+}
+
+bool libretro::CoreManager::read(size_t address, void* const data, size_t const size) const {
+  auto const bytes = static_cast<uint8_t*>(data);
+
+  for (size_t i = 0; i < size; i++, address++) {
+    auto const host = static_cast<uint8_t const*>(translate(address));
+
+    if (host == nullptr) {
+      return false;
+    }
+
+    bytes[i] = *host;
+  }
+
+  return true;
+}
+
+void* libretro::CoreManager::translateSlow(size_t const address) const {
+  // Subtract start, pick off disconnect, apply len, add offset
+  for (auto const& desc : _memoryMap) {
+    if (((desc.start ^ address) & desc.select) != 0) {
+      continue;
+    }
+
+    if (desc.ptr == nullptr || desc.len == 0) {
+      return nullptr;
+    }
+
+    size_t offset = reduce(address - desc.start, desc.disconnect);
+
+    while (offset >= desc.len) {
+      offset -= highestBit(offset);
+    }
+
+    return static_cast<uint8_t*>(desc.ptr) + desc.offset + offset;
+  }
+
+  return nullptr;
+}
+
+void libretro::CoreManager::buildPageTable() {
+  size_t const pageMask = kPageSize - 1;
+  size_t const levelMask = (kPageSize << kLevelBits) - 1;
+
+  for (size_t top = 0; top < kLevelSize; top++) {
+    size_t const first = top << (kPageBits + kLevelBits);
+    bool used = false;
+
+    _pageTable[top].reset();
+
+    // Most of the address space is usually empty, only fill the second level
+    // where some descriptor with memory can claim an address
+    for (auto const& desc : _memoryMap) {
+      if (desc.ptr != nullptr && ((desc.start ^ first) & desc.select & ~levelMask) == 0) {
+        used = true;
+        break;
+      }
+    }
+
+    if (!used) {
+      continue;
+    }
+
+    Page* const pages = new Page[kLevelSize];
+    _pageTable[top].reset(pages);
+
+    for (size_t index = 0; index < kLevelSize; index++) {
+      size_t const address = first | (index << kPageBits);
+      Page& page = pages[index];
+
+      page.data = nullptr;
+      page.slow = false;
+
+      for (auto const& desc : _memoryMap) {
+        if (((desc.start ^ address) & desc.select & ~pageMask) != 0) {
+          // No address in the page matches
+          continue;
+        }
+
+        if ((desc.select & pageMask) != 0) {
+          // Only some addresses do, the others can belong to other descriptors
+          page.slow = true;
+        }
+        else if (desc.ptr != nullptr && desc.len != 0) {
+          // The page is linear unless the address bits inside it are
+          // disconnected, or if len wraps inside it
+          if ((desc.disconnect & pageMask) != 0 || (desc.len & pageMask) != 0) {
+            page.slow = true;
+          }
+          else {
+            page.data = static_cast<uint8_t*>(translateSlow(address));
+          }
+        }
+
+        break;
+      }
+    }
   }
-  while (_samplesCount == 0);
-  
-  _audio->mix(_samples, _samplesCount / 2);
 }
 
 bool libretro::CoreManager::initCore() {
@@ -277,6 +477,8 @@ error:
 void libretro::CoreManager::reset() {
   _gameLoaded = false;
   _samplesCount = 0;
+  _audioVideoEnable = kEnableVideo | kEnableAudio;
+  _frameCount = 0;
   _libretroPath.clear();
   _performanceLevel = 0;
   _pixelFormat = RETRO_PIXEL_FORMAT_UNKNOWN;
@@ -290,6 +492,8 @@ void libretro::CoreManager::reset() {
   _controllerInfo.clear();
   _ports.clear();
   _memoryMap.clear();
+  _memoryMapVersion = 0;
+  buildPageTable();
 
   _systemInfo.libraryName.clear();
   _systemInfo.libraryVersion.clear();
@@ -710,6 +914,8 @@ bool libretro::CoreManager::setMemoryMaps(struct retro_memory_map const* const d
   }
 
   preprocessMemoryDescriptors(&_memoryMap);
+  _memoryMapVersion++;
+  buildPageTable();
 
   debug("retro_memory_map");
   debug("  flags  ptr              offset   start    select   disconn  len      addrspace");
@@ -814,7 +1020,7 @@ bool libretro::CoreManager::setSupportAchievements(bool const data) {
 }
 
 bool libretro::CoreManager::getAudioVideoEnable(int* const data) const {
-  *data = 3; // Enable audio and video.
+  *data = _audioVideoEnable;
   return true;
 }
 
@@ -958,7 +1164,9 @@ void libretro::CoreManager::videoRefreshCallback(void const* data,
                                                  unsigned const width,
                                                  unsigned const height,
                                                  size_t const pitch) {
-  _video->refresh(data, width, height, pitch);
+  if ((_audioVideoEnable & kEnableVideo) != 0) {
+    _video->refresh(data, width, height, pitch);
+  }
 }
 
 size_t libretro::CoreManager::audioSampleBatchCallback(int16_t const* const data, size_t const frames) {
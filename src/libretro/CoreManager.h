@@ -27,12 +27,26 @@ SOFTWARE.
 #include "Core.h"
 #include "Components.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <stdarg.h>
+#include <stdint.h>
 
 namespace libretro
 {
+  class CoreManager;
+
+  /**
+   * Gets notified after each frame, right after retro_run returns, when
+   * memory is consistent.
+   */
+  class FrameListener {
+  public:
+    virtual ~FrameListener() {}
+    virtual void frame(CoreManager* const core, uint64_t const frame) = 0;
+  };
+
   /**
    * CoreManager contains a Core instance, and provides high level functionality.
    */
@@ -45,13 +59,47 @@ namespace libretro
               InputComponent* const input,
               LoaderComponent* const loader);
 
-    bool loadCore(std::string const& corePath);
+    // With privateCopy, the core is loaded from a copy of its file so that it
+    // doesn't share its global state with other instances of the same core,
+    // which can then each run on their own thread.
+    bool loadCore(std::string const& corePath, bool const privateCopy);
     bool loadGame(std::string const& gamePath);
 
+    // Unloads the game and the core, also after a failed load.
     void destroy();
     
     void step();
 
+    // Like step(), but the video of the frame is discarded. For run-ahead,
+    // where the frame shown is one run later.
+    void stepWithoutVideo();
+
+    // Runs a single frame without sending its audio to the audio component.
+    void runFrame();
+
+    // Runs a single frame telling the core that its audio and video will be
+    // discarded, so that it can skip generating them, and discards them in
+    // case it doesn't. For fast-forward and replays.
+    void skipFrame();
+
+    // Like skipFrame(), but without notifying the frame listeners. For
+    // replays of past frames that are undone by loading a state, which the
+    // listeners must not mistake for new frames.
+    void replayFrame();
+
+    // Runs frames that are going to be undone by loading a state, without
+    // notifying the frame listeners and discarding their audio. Only the
+    // video of the last one goes to the video component.
+    void runAhead(unsigned const frames);
+
+    size_t serializeSize();
+    bool   serialize(void* const data, size_t const size);
+    // Also sets the frame count back to the one the state was saved at.
+    bool   unserialize(void const* const data, size_t const size, uint64_t const frame);
+
+    void addFrameListener(FrameListener* const listener);
+    void removeFrameListener(FrameListener* const listener);
+
     unsigned getApiVersion()            const { return _core.apiVersion(); }
     unsigned getRegion()                const { return _core.getRegion(); }
     void*    getMemoryData(unsigned id) const { return _core.getMemoryData(id); }
@@ -62,6 +110,7 @@ namespace libretro
     bool                    getSupportsNoGame()      const { return _supportsNoGame; }
     unsigned                getRotation()            const { return _rotation; }
     bool                    getSupportAchievements() const { return _supportAchievements; }
+    uint64_t                getFrameCount()          const { return _frameCount; }
     
     std::vector<InputDescriptor> const&  getInputDescriptors() const { return _inputDescriptors; }
     std::vector<Variable> const&         getVariables()        const { return _variables; }
@@ -70,12 +119,74 @@ namespace libretro
     SystemInfo const&                    getSystemInfo()       const { return _systemInfo; }
     SystemAVInfo const&                  getSystemAVInfo()     const { return _systemAVInfo; }
     std::vector<MemoryDescriptor> const& getMemoryMap()        const { return _memoryMap; }
+    // Changes every time the core sets a new memory map, i.e. on bank swaps.
+    unsigned                             getMemoryMapVersion() const { return _memoryMapVersion; }
+
+    // Translates an emulated address to a host pointer using the memory map,
+    // or returns nullptr if the address isn't mapped. Pages where the mapping
+    // isn't linear go through the descriptors.
+    void* translate(size_t const address) const {
+      if (static_cast<uint64_t>(address) < kTableSize) {
+        Page const* const pages = _pageTable[address >> (kPageBits + kLevelBits)].get();
+
+        if (pages == nullptr) {
+          return nullptr;
+        }
+
+        Page const& page = pages[(address >> kPageBits) & (kLevelSize - 1)];
+
+        if (page.data != nullptr) {
+          return page.data + (address & (kPageSize - 1));
+        }
+        else if (!page.slow) {
+          return nullptr;
+        }
+      }
+
+      return translateSlow(address);
+    }
+
+    // Copies size bytes starting at an emulated address, returns false if
+    // any of them isn't mapped.
+    bool read(size_t address, void* const data, size_t const size) const;
     
   protected:
     enum {
       kSampleCount = 8192
     };
 
+    enum {
+      kEnableVideo = 1,
+      kEnableAudio = 2
+    };
+
+    // Two-level table over the low 4 GiB of the emulated address space, in
+    // pages of 4 KiB.
+    enum : uint64_t {
+      kPageBits  = 12,
+      kPageSize  = uint64_t(1) << kPageBits,
+      kLevelBits = 10,
+      kLevelSize = uint64_t(1) << kLevelBits,
+      kTableSize = uint64_t(1) << (kPageBits + 2 * kLevelBits)
+    };
+
+    struct Page {
+      // The host address of the first byte of the page.
+      uint8_t* data;
+      // Set when the page is mapped but not linearly.
+      bool     slow;
+    };
+
+    void  buildPageTable();
+    void* translateSlow(size_t const address) const;
+
+    // Runs a frame with the given RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE
+    // flags and sends its audio to the audio component.
+    void step(int const audioVideoEnable);
+
+    // Tells the core about the devices plugged since the last frame.
+    void updatePorts();
+
     // Initialization
     bool initCore();
     bool initAV();
@@ -174,6 +285,12 @@ namespace libretro
     int16_t _samples[kSampleCount];
     size_t  _samplesCount;
 
+    // Flags for RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE.
+    int _audioVideoEnable;
+
+    uint64_t                    _frameCount;
+    std::vector<FrameListener*> _frameListeners;
+
     std::string             _libretroPath;
     unsigned                _performanceLevel;
     enum retro_pixel_format _pixelFormat;
@@ -188,6 +305,8 @@ namespace libretro
     std::vector<Variable>         _variables;
     std::vector<SubsystemInfo>    _subsystemInfo;
     std::vector<MemoryDescriptor> _memoryMap;
+    unsigned                      _memoryMapVersion;
+    std::unique_ptr<Page[]>       _pageTable[kLevelSize];
     std::vector<ControllerInfo>   _controllerInfo;
     std::vector<unsigned>         _ports;
   };
@@ -3,7 +3,18 @@
 #include "components/Input.h"
 #include "components/Video.h"
 #include "Memory.h"
+#include "FrameDiff.h"
+#include "Correlation.h"
+#include "Recorder.h"
+#include "Capture.h"
+#include "Session.h"
+#include "Movie.h"
+#include "Rewind.h"
+#include "RunAhead.h"
+#include "SaveStates.h"
+#include "Sram.h"
 #include "CoreInfo.h"
+#include "SpscQueue.h"
 
 #include "imguiext/imguial_term.h"
 #include "imguiext/imguial_button.h"
@@ -18,6 +29,8 @@
 #include <SDL.h>
 #include <SDL_opengl.h>
 
+#include <mutex>
+
 // Ugh
 using json = nlohmann::json;
 
@@ -41,6 +54,24 @@ protected:
     kRunning,
   };
 
+  struct Command
+  {
+    enum class Type
+    {
+      kEvent,
+      kRun,
+      kPause,
+      kSpeed,
+      kDirtyTracking,
+      kQuit
+    };
+
+    Type      type;
+    SDL_Event event;
+    unsigned  speed;
+    bool      enable;
+  };
+
   SDL_Window*       _window;
   SDL_GLContext     _glContext;
   SDL_AudioSpec     _audioSpec;
@@ -55,16 +86,42 @@ protected:
   Loader _loader;
   Memory _memory;
 
+  FrameDiff _diff;
+  unsigned _diffGeneration;
+  Correlation _correlation;
+  Recorder _recorder;
+  Capture _capture;
+  Session _session;
+  Movie _movie;
+  Rewind _rewind;
+  RunAhead _runAhead;
+  SaveStates _saveStates;
+  Sram _sram;
+
   State                 _state;
   libretro::CoreManager _core;
   std::string           _coreKey;
   std::string           _extensions;
 
+  // The emulation thread runs frames while holding _emulation, the UI thread
+  // takes it to touch anything that the emulation also uses
+  SDL_Thread*              _emulationThread;
+  std::mutex               _emulation;
+  SpscQueue<Command, 1024> _commands;
+
+  // Frames run per tick of the emulation thread, 0 runs as fast as possible.
+  unsigned _speed;
+
+  // Off by default, clearing the soft-dirty bits write-protects every page
+  // of the process and not only the emulated memory.
+  bool _dirtyTracking;
+
   json        _appCfg;
   json        _coreCfg;
   json        _inputCfg;
   std::string _corePath;
   std::string _gamePath;
+  std::string _coreFile;
 
   static void s_audioCallback(void* udata, Uint8* stream, int len)
   {
@@ -82,6 +139,175 @@ protected:
     }
   }
 
+  static int s_emulationThread(void* udata)
+  {
+    Application* app = (Application*)udata;
+    app->emulate();
+    return 0;
+  }
+
+  void send(Command const& command)
+  {
+    while (!_commands.push(command))
+    {
+      SDL_Delay(1);
+    }
+  }
+
+  void send(Command::Type type)
+  {
+    Command command;
+    command.type = type;
+    send(command);
+  }
+
+  // Runs the frames of one tick of the emulation thread. With fast-forward,
+  // all but the last one are run with audio and video disabled; the tools
+  // only see the last one, except for the frame listeners.
+  void tick(unsigned speed, Uint64 period)
+  {
+    if (_rewind.rewinding() && !_session.recording() && !_movie.active())
+    {
+      // Back one saved state per tick whatever the speed, the frame run
+      // after loading it shows it
+      std::string error;
+
+      if (!_rewind.step(&error))
+      {
+        _logger.printf(RETRO_LOG_ERROR, "%s", error.c_str());
+        return;
+      }
+
+      speed = 1;
+    }
+
+    if (speed == 0)
+    {
+      Uint64 const end = SDL_GetPerformanceCounter() + period;
+
+      while (SDL_GetPerformanceCounter() < end)
+      {
+        _core.skipFrame();
+      }
+    }
+    else
+    {
+      for (unsigned i = 1; i < speed; i++)
+      {
+        _core.skipFrame();
+      }
+    }
+
+    if (_runAhead.enabled() && !_session.recording() && !_movie.active())
+    {
+      _runAhead.step();
+    }
+    else
+    {
+      _core.step();
+    }
+
+    _memory.update();
+    diffFrame();
+    _correlation.update();
+    _recorder.update();
+  }
+
+  void emulate()
+  {
+    Uint64 const frequency = SDL_GetPerformanceFrequency();
+    Uint64 deadline = SDL_GetPerformanceCounter();
+    bool running = false;
+    unsigned speed = 1;
+
+    for (;;)
+    {
+      Uint64 period = 0;
+
+      {
+        std::lock_guard<std::mutex> lock(_emulation);
+        Command command;
+
+        while (_commands.pop(&command))
+        {
+          switch (command.type)
+          {
+          case Command::Type::kEvent:
+            _input.processEvent(&command.event);
+            break;
+
+          case Command::Type::kRun:
+            running = true;
+            deadline = SDL_GetPerformanceCounter();
+            break;
+
+          case Command::Type::kPause:
+            running = false;
+            break;
+
+          case Command::Type::kSpeed:
+            speed = command.speed;
+            deadline = SDL_GetPerformanceCounter();
+            break;
+
+          case Command::Type::kDirtyTracking:
+            if (_diff.setDirtyTracking(command.enable) != command.enable)
+            {
+              _logger.printf(RETRO_LOG_INFO, "Soft-dirty page tracking is not available, memory will be fully scanned every frame");
+            }
+
+            break;
+
+          case Command::Type::kQuit:
+            return;
+          }
+        }
+
+        // Also while paused, so that states are saved and loaded
+        _saveStates.update();
+        _sram.update();
+
+        if (running)
+        {
+          double const fps = _core.getSystemAVInfo().timing.fps;
+          period = (Uint64)(frequency / (fps > 0.0 ? fps : 60.0));
+          tick(speed, period);
+        }
+      }
+
+      if (!running || speed == 0)
+      {
+        // Unthrottled ticks take a whole period, let the UI have the lock
+        SDL_Delay(1);
+        continue;
+      }
+
+      // Pace on the core's frame rate, not on the UI; when too far behind,
+      // start over from now instead of running a burst of frames
+      Uint64 const now = SDL_GetPerformanceCounter();
+      deadline += period;
+
+      if (now > deadline + period * 4)
+      {
+        deadline = now;
+      }
+      else if (now < deadline)
+      {
+        Uint32 const ms = (Uint32)((deadline - now) * 1000 / frequency);
+
+        if (ms > 1)
+        {
+          SDL_Delay(ms - 1);
+        }
+
+        while (SDL_GetPerformanceCounter() < deadline)
+        {
+          // Spin for the last millisecond, SDL_Delay isn't that precise
+        }
+      }
+    }
+  }
+
   void saveConfig()
   {
     _appCfg["corecfg"][_coreKey] = _coreCfg;
@@ -289,6 +515,15 @@ public:
       ok = ok && _audio.init(&_logger, _audioSpec.freq, &_fifo);
       ok = ok && _input.init(&_logger); // &_inputCfg
       ok = ok && _memory.init(&_core);
+      ok = ok && _correlation.init(&_diff, &_video);
+      ok = ok && _recorder.init(&_memory);
+      ok = ok && _capture.init(&_memory, &_input);
+      ok = ok && _movie.init(&_core, &_memory, &_input, &_logger);
+      ok = ok && _session.init(&_core, &_movie, &_memory);
+      ok = ok && _rewind.init(&_core);
+      ok = ok && _runAhead.init(&_logger, &_config, &_video, &_input, &_loader, &_core);
+      ok = ok && _saveStates.init(&_logger, &_config, &_core);
+      ok = ok && _sram.init(&_logger, &_config, &_core);
 
       if (!ok)
       {
@@ -298,6 +533,11 @@ public:
         SDL_DestroyWindow(_window);
         return false;
       }
+
+      _core.addFrameListener(&_capture);
+      _core.addFrameListener(&_session);
+      _core.addFrameListener(&_movie);
+      _core.addFrameListener(&_rewind);
     }
 
     {
@@ -310,14 +550,42 @@ public:
       }
     }
 
+    _diffGeneration = 0;
+    _speed = 1;
+    _dirtyTracking = false;
     _state = State::kGetCorePath;
+
+    _emulationThread = SDL_CreateThread(s_emulationThread, "Emulation", this);
+
+    if (_emulationThread == NULL)
+    {
+      _logger.printf(RETRO_LOG_ERROR, "Error creating the emulation thread: %s", SDL_GetError());
+      return false;
+    }
+
     return true;
   }
 
   void destroy()
   {
+    send(Command::Type::kQuit);
+    SDL_WaitThread(_emulationThread, NULL);
+
     saveConfig();
 
+    _correlation.destroy();
+    _recorder.destroy();
+    _core.removeFrameListener(&_capture);
+    _capture.destroy();
+    _core.removeFrameListener(&_session);
+    _session.destroy();
+    _core.removeFrameListener(&_movie);
+    _movie.destroy();
+    _core.removeFrameListener(&_rewind);
+    _rewind.destroy();
+    _runAhead.destroy();
+    _saveStates.destroy();
+    _sram.destroy();
     _memory.destroy();
     _input.destroy();
     _audio.destroy();
@@ -364,15 +632,27 @@ public:
           case SDL_CONTROLLERAXISMOTION:
           case SDL_KEYUP:
           case SDL_KEYDOWN:
-            _input.processEvent(&event);
+            {
+              Command command;
+              command.type = Command::Type::kEvent;
+              command.event = event;
+              send(command);
+            }
             break;
           }
         }
       }
 
-      if (_state == State::kRunning)
+      // The tool windows read and change the emulation state, so the frame
+      // is built between two emulated frames. Don't wait for the emulation
+      // thread: keep the previous frame on screen and try again, the tools
+      // would flicker if only they were left out
+      std::unique_lock<std::mutex> lock(_emulation, std::try_to_lock);
+
+      if (!lock.owns_lock())
       {
-        _core.step();
+        SDL_Delay(1);
+        continue;
       }
 
       ImGui_ImplOpenGL2_NewFrame();
@@ -381,6 +661,9 @@ public:
 
       draw();
 
+      // Only building the widgets needs the lock, not rendering them
+      lock.unlock();
+      _capture.runSearch();
       ImGui::Render();
 
       glViewport(0, 0, (int)ImGui::GetIO().DisplaySize.x, (int)ImGui::GetIO().DisplaySize.y);
@@ -395,6 +678,22 @@ public:
     while (!done);
   }
 
+  void diffFrame()
+  {
+    if (_diffGeneration != _memory.generation())
+    {
+      _diff.reset();
+      _diffGeneration = _memory.generation();
+
+      for (auto const& region : _memory.regions())
+      {
+        _diff.addRegion(region.address, region.data, region.size);
+      }
+    }
+
+    _diff.update();
+  }
+
   void drawCoreControls()
   {
     ImVec2 size = ImVec2(100.0f, 0.0f);
@@ -412,6 +711,7 @@ public:
     {
       _logger.printf(RETRO_LOG_DEBUG, "Running");
       _state = State::kRunning;
+      send(Command::Type::kRun);
     }
 
     pressed = ImGuiAl::Button(ICON_FA_PAUSE " Pause", _state == State::kRunning, size);
@@ -421,9 +721,49 @@ public:
     {
       _logger.printf(RETRO_LOG_DEBUG, "Paused");
       _state = State::kPaused;
+      send(Command::Type::kPause);
     }
 
     pressed = ImGuiAl::Button(ICON_FA_STOP " Stop", _state == State::kPaused, size);
+    ImGui::SameLine();
+
+    {
+      static char const* const speeds[] = {"Unlimited", "1x", "2x", "4x", "8x", "16x", "32x"};
+      int index = 0;
+
+      for (unsigned speed = _speed; speed != 0; speed >>= 1)
+      {
+        index++;
+      }
+
+      ImGui::PushItemWidth(size.x);
+
+      if (ImGui::Combo(ICON_FA_FORWARD " Speed", &index, speeds, IM_ARRAYSIZE(speeds)))
+      {
+        _speed = index == 0 ? 0 : 1U << (index - 1);
+
+        Command command;
+        command.type = Command::Type::kSpeed;
+        command.speed = _speed;
+        send(command);
+      }
+
+      ImGui::PopItemWidth();
+      ImGui::SameLine();
+    }
+
+    if (ImGui::Checkbox("Dirty pages", &_dirtyTracking))
+    {
+      Command command;
+      command.type = Command::Type::kDirtyTracking;
+      command.enable = _dirtyTracking;
+      send(command);
+    }
+
+    if (ImGui::IsItemHovered())
+    {
+      ImGui::SetTooltip("Only diff the memory pages written since the last frame, using the soft-dirty\nbits of Linux. Each frame, the first write to every page of the process faults.");
+    }
 
     if (pressed)
     {
@@ -440,8 +780,18 @@ public:
       _coreCfg = json::object();
       _inputCfg = json::object();
       _extensions.clear();
+      _sram.reset();
       _core.destroy();
       _memory.reset();
+      _diff.reset();
+      _correlation.reset();
+      _recorder.reset();
+      _capture.reset();
+      _session.reset();
+      _movie.reset();
+      _rewind.reset();
+      _runAhead.reset();
+      _saveStates.reset();
 
       _state = State::kGetCorePath;
     }
@@ -489,12 +839,13 @@ public:
           _inputCfg = cfg[_coreKey];
         }
         
-        _core.init(&_logger, &_config, &_video, &_audio, &_input, &_loader);
+        _core.init(&_logger, &_config, &_video, &_audio, &_session, &_loader);
 
-        if (_core.loadCore(path))
+        if (_core.loadCore(path, false))
         {
           ImGuiFs::PathGetDirectoryName(path, temp);
           _corePath = temp;
+          _coreFile = path;
 
           const char* ext = _core.getSystemInfo().validExtensions.c_str();
 
@@ -536,8 +887,13 @@ public:
           char temp[ImGuiFs::MAX_PATH_BYTES];
           ImGuiFs::PathGetDirectoryName(path, temp);
           _gamePath = temp;
+          _runAhead.setContent(_coreFile, path);
+          _movie.setContent(_coreFile, path);
+          _saveStates.setContent(path);
+          _sram.setContent(path);
           
           _state = State::kRunning;
+          send(Command::Type::kRun);
         }
         else
         {
@@ -561,31 +917,14 @@ public:
   {
     ImGui::DockSpaceOverViewport();
 
-    if (ImGui::Begin(ICON_FA_COG " Core"))
-      drawCoreControls();
-    ImGui::End();
-
+    // The log and the video have their own handoff from the emulation thread
     if (ImGui::Begin(ICON_FA_COMMENT " Log"))
       _logger.draw();
     ImGui::End();
     
-    if (ImGui::Begin(ICON_FA_WRENCH " Configuration"))
-      _config.draw();
-    ImGui::End();
-    
     if (ImGui::Begin(ICON_FA_DESKTOP " Video"))
       _video.draw();
     ImGui::End();
-    
-    if (ImGui::Begin(ICON_FA_VOLUME_UP " Audio"))
-      _audio.draw();
-    ImGui::End();
-    
-    if (ImGui::Begin(ICON_FA_GAMEPAD " Input"))
-      _input.draw();
-    ImGui::End();
-
-    _memory.draw(_state == State::kRunning);
 
     ImGui::ShowDemoWindow();
 
@@ -601,6 +940,34 @@ public:
 
     static Test test;
     test.draw();
+
+    // The other windows read and change the emulation state, run holds the
+    // emulation lock while they're built
+    if (ImGui::Begin(ICON_FA_COG " Core"))
+      drawCoreControls();
+    ImGui::End();
+    
+    if (ImGui::Begin(ICON_FA_WRENCH " Configuration"))
+      _config.draw();
+    ImGui::End();
+    
+    if (ImGui::Begin(ICON_FA_VOLUME_UP " Audio"))
+      _audio.draw();
+    ImGui::End();
+    
+    if (ImGui::Begin(ICON_FA_GAMEPAD " Input"))
+      _input.draw();
+    ImGui::End();
+
+    _memory.draw(_state == State::kRunning);
+    _correlation.draw(_state == State::kRunning);
+    _recorder.draw(_state == State::kRunning);
+    _capture.draw(_state == State::kRunning);
+    _session.draw(_state == State::kRunning);
+    _movie.draw(_state == State::kRunning);
+    _rewind.draw(_state == State::kRunning);
+    _runAhead.draw(_state == State::kRunning);
+    _saveStates.draw(_state == State::kRunning);
   }
 };
 